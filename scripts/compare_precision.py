@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+
+# compares the calls of a freebayes built with the default (long double)
+# probability precision against one built with 'make double-precision'
+#
+# build each, keeping the binaries apart:
+#
+#     make -C src clean && make -C src && cp bin/freebayes freebayes.long-double
+#     make -C src clean && make -C src double-precision && cp bin/freebayes freebayes.double
+#
+# then run both on a dataset and compare their output:
+#
+#     compare_precision.py freebayes.long-double freebayes.double -- -f ref.fa aln.bam
+#
+# or compare the VCFs of runs made already:
+#
+#     compare_precision.py --vcfs long-double.vcf double.vcf
+#
+# records are matched on CHROM, POS, REF and ALT.  the script reports records
+# called by only one build, QUAL, GQ and GL differences beyond the tolerances,
+# and differing genotypes, and exits 1 if there were any.
+
+from __future__ import print_function
+import sys
+import os
+import subprocess
+import tempfile
+from optparse import OptionParser
+
+
+def read_vcf(filename):
+    records = {}
+    order = []
+    samples = []
+    for line in open(filename):
+        if line.startswith("##"):
+            continue
+        fields = line.rstrip("\n").split("\t")
+        if line.startswith("#"):
+            samples = fields[9:]
+            continue
+        key = (fields[0], int(fields[1]), fields[3], fields[4])
+        genotypes = {}
+        if len(fields) > 9:
+            format = fields[8].split(":")
+            for sample, values in zip(samples, fields[9:]):
+                genotypes[sample] = dict(zip(format, values.split(":")))
+        records[key] = (fields[5], genotypes)
+        order.append(key)
+    return records, order
+
+
+def floats(value):
+    try:
+        return [float(v) for v in value.split(",")]
+    except ValueError:
+        return None
+
+
+def differs(a, b, tolerance):
+    return abs(a - b) > tolerance * max(1.0, abs(a))
+
+
+def compare(baseline_vcf, test_vcf, options):
+    baseline, order = read_vcf(baseline_vcf)
+    test, test_order = read_vcf(test_vcf)
+
+    only_baseline = [k for k in order if k not in test]
+    only_test = [k for k in test_order if k not in baseline]
+    compared = 0
+    problems = 0
+    max_qual = 0.0
+    max_gl = 0.0
+
+    def report(key, message):
+        print("%s:%i %s/%s\t%s" % (key[0], key[1], key[2], key[3], message))
+
+    for key in only_baseline:
+        report(key, "only called by the baseline")
+    for key in only_test:
+        report(key, "only called by the test build")
+
+    for key in order:
+        if key not in test:
+            continue
+        compared += 1
+        qual, genotypes = baseline[key]
+        test_qual, test_genotypes = test[key]
+        q, tq = float(qual), float(test_qual)
+        max_qual = max(max_qual, abs(q - tq))
+        if differs(q, tq, options.qual_tolerance):
+            report(key, "QUAL %s != %s" % (qual, test_qual))
+            problems += 1
+        for sample, values in genotypes.items():
+            test_values = test_genotypes.get(sample, {})
+            if values.get("GT") != test_values.get("GT"):
+                report(key, "%s GT %s != %s" % (sample, values.get("GT"), test_values.get("GT")))
+                problems += 1
+            if "GQ" in values and "GQ" in test_values:
+                gq, tgq = floats(values["GQ"]), floats(test_values["GQ"])
+                if gq and tgq and differs(gq[0], tgq[0], options.qual_tolerance):
+                    report(key, "%s GQ %s != %s" % (sample, values["GQ"], test_values["GQ"]))
+                    problems += 1
+            if "GL" in values and "GL" in test_values:
+                gl, tgl = floats(values["GL"]), floats(test_values["GL"])
+                if gl is None or tgl is None or len(gl) != len(tgl):
+                    if values["GL"] != test_values["GL"]:
+                        report(key, "%s GL %s != %s" % (sample, values["GL"], test_values["GL"]))
+                        problems += 1
+                    continue
+                for l, tl in zip(gl, tgl):
+                    max_gl = max(max_gl, abs(l - tl))
+                if any(differs(l, tl, options.gl_tolerance) for l, tl in zip(gl, tgl)):
+                    report(key, "%s GL %s != %s" % (sample, values["GL"], test_values["GL"]))
+                    problems += 1
+
+    print("records compared: %i, only in baseline: %i, only in test: %i" % (compared, len(only_baseline), len(only_test)),
+          file=sys.stderr)
+    print("largest QUAL difference: %g, largest GL difference: %g" % (max_qual, max_gl), file=sys.stderr)
+    print("differences beyond tolerance: %i" % (problems + len(only_baseline) + len(only_test)), file=sys.stderr)
+    return problems == 0 and not only_baseline and not only_test
+
+
+def run(binary, args, vcf):
+    command = [binary] + args + ["--vcf", vcf]
+    print(" ".join(command), file=sys.stderr)
+    if subprocess.call(command) != 0:
+        print("error: %s failed" % binary, file=sys.stderr)
+        sys.exit(2)
+
+
+def main():
+    usage = "usage: %prog [options] BASELINE_BINARY TEST_BINARY -- FREEBAYES_ARGS...\n" \
+            "       %prog [options] --vcfs BASELINE_VCF TEST_VCF"
+    parser = OptionParser(usage=usage)
+    parser.add_option("--vcfs", action="store_true", default=False,
+                      help="compare two VCF files rather than running freebayes")
+    parser.add_option("--qual-tolerance", type="float", default=1e-3,
+                      help="relative difference allowed in QUAL and GQ (default %default)")
+    parser.add_option("--gl-tolerance", type="float", default=1e-3,
+                      help="relative difference allowed in each GL (default %default)")
+    parser.add_option("--keep", action="store_true", default=False,
+                      help="keep the VCFs written when running freebayes")
+    options, args = parser.parse_args()
+
+    if options.vcfs:
+        if len(args) != 2:
+            parser.error("--vcfs takes two VCF files")
+        ok = compare(args[0], args[1], options)
+    else:
+        if len(args) < 3:
+            parser.error("give two freebayes binaries, then the arguments to run them with")
+        directory = tempfile.mkdtemp(prefix="compare_precision.")
+        baseline_vcf = os.path.join(directory, "baseline.vcf")
+        test_vcf = os.path.join(directory, "test.vcf")
+        run(args[0], args[2:], baseline_vcf)
+        run(args[1], args[2:], test_vcf)
+        ok = compare(baseline_vcf, test_vcf, options)
+        if options.keep:
+            print("output kept in %s" % directory, file=sys.stderr)
+        else:
+            os.remove(baseline_vcf)
+            os.remove(test_vcf)
+            os.rmdir(directory)
+
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
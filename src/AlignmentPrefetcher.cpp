@@ -0,0 +1,142 @@
+#include "AlignmentPrefetcher.h"
+
+AlignmentPrefetcher::AlignmentPrefetcher(BamMultiReader& r, int capacity)
+    : reader(r)
+    , ring(capacity)
+    , head(0)
+    , tail(0)
+    , finished(false)
+    , stopping(false)
+    , producerWaiting(false)
+    , consumerWaiting(false)
+    , running(false)
+{
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&notEmpty, NULL);
+    pthread_cond_init(&notFull, NULL);
+}
+
+AlignmentPrefetcher::~AlignmentPrefetcher(void) {
+    stop();
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&notEmpty);
+    pthread_cond_destroy(&notFull);
+}
+
+bool AlignmentPrefetcher::SetRegion(const int& leftRefID, const int& leftPosition,
+                                    const int& rightRefID, const int& rightPosition) {
+    // alignments decoded from the previous region are discarded
+    stop();
+    return reader.SetRegion(leftRefID, leftPosition, rightRefID, rightPosition);
+}
+
+// the producer is started on demand, so that the reader may be positioned
+// before it begins to read
+void AlignmentPrefetcher::start(void) {
+    head = 0;
+    tail = 0;
+    finished = false;
+    stopping = false;
+    producerWaiting = false;
+    consumerWaiting = false;
+    if (pthread_create(&producer, NULL, &AlignmentPrefetcher::runProducer, this)) {
+        cerr << "ERROR(freebayes): could not start alignment reading thread" << endl;
+        exit(1);
+    }
+    running = true;
+}
+
+void AlignmentPrefetcher::stop(void) {
+    if (!running) return;
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_signal(&notFull);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(producer, NULL);
+    running = false;
+}
+
+void* AlignmentPrefetcher::runProducer(void* prefetcher) {
+    ((AlignmentPrefetcher*) prefetcher)->produce();
+    return NULL;
+}
+
+// the waiting flags and ring indexes are each written by one side and read by
+// the other; the full barriers between writing one and reading the other
+// ensure that a side about to sleep is always seen, and woken, by the other
+void AlignmentPrefetcher::produce(void) {
+
+    while (true) {
+
+        if (tail - head == ring.size()) {
+            pthread_mutex_lock(&mutex);
+            producerWaiting = true;
+            __sync_synchronize();
+            while (tail - head == ring.size() && !stopping) {
+                pthread_cond_wait(&notFull, &mutex);
+            }
+            producerWaiting = false;
+            pthread_mutex_unlock(&mutex);
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        if (!reader.GetNextAlignment(ring[tail % ring.size()])) {
+            finished = true;
+        } else {
+            __sync_synchronize(); // publish the alignment before the index
+            ++tail;
+        }
+        __sync_synchronize();
+
+        if (consumerWaiting) {
+            pthread_mutex_lock(&mutex);
+            pthread_cond_signal(&notEmpty);
+            pthread_mutex_unlock(&mutex);
+        }
+
+        if (finished) {
+            break;
+        }
+
+    }
+
+}
+
+bool AlignmentPrefetcher::GetNextAlignment(BamAlignment& alignment) {
+
+    if (!running) {
+        start();
+    }
+
+    if (head == tail) {
+        pthread_mutex_lock(&mutex);
+        consumerWaiting = true;
+        __sync_synchronize();
+        while (head == tail && !finished) {
+            pthread_cond_wait(&notEmpty, &mutex);
+        }
+        consumerWaiting = false;
+        pthread_mutex_unlock(&mutex);
+        if (head == tail) {
+            return false; // finished, and the ring is drained
+        }
+    }
+
+    __sync_synchronize(); // read the alignment only after its index
+    alignment = ring[head % ring.size()];
+    __sync_synchronize();
+    ++head;
+    __sync_synchronize();
+
+    if (producerWaiting) {
+        pthread_mutex_lock(&mutex);
+        pthread_cond_signal(&notFull);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    return true;
+
+}
@@ -0,0 +1,60 @@
+#ifndef ALIGNMENTPREFETCHER_H
+#define ALIGNMENTPREFETCHER_H
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <pthread.h>
+#include "api/BamMultiReader.h"
+
+using namespace std;
+using namespace BamTools;
+
+// the number of alignments which may be decoded ahead of their use
+#define ALIGNMENT_PREFETCH_SIZE 256
+
+// reads alignments from a BamMultiReader in a separate thread, so that BGZF
+// inflation and record decoding overlap with allele registration and
+// genotyping in the calling thread
+//
+// decoded alignments are passed through a single-producer, single-consumer
+// ring; each side only takes the lock to sleep when the ring is full or empty
+class AlignmentPrefetcher {
+
+public:
+
+    AlignmentPrefetcher(BamMultiReader& reader, int capacity = ALIGNMENT_PREFETCH_SIZE);
+    ~AlignmentPrefetcher(void);
+
+    // these replace the BamMultiReader methods of the same name
+    // the reader must not be used directly while the prefetcher is in use
+    bool SetRegion(const int& leftRefID, const int& leftPosition,
+                   const int& rightRefID, const int& rightPosition);
+    bool GetNextAlignment(BamAlignment& alignment);
+
+private:
+
+    BamMultiReader& reader;
+    vector<BamAlignment> ring;
+
+    volatile unsigned long head;  // count of alignments consumed
+    volatile unsigned long tail;  // count of alignments decoded
+    volatile bool finished;       // the reader has no more alignments
+    volatile bool stopping;       // the producer should exit
+    volatile bool producerWaiting;
+    volatile bool consumerWaiting;
+
+    bool running;
+    pthread_t producer;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+
+    void start(void);
+    void stop(void);
+    void produce(void);
+    static void* runProducer(void* prefetcher);
+
+};
+
+#endif
@@ -2,6 +2,22 @@
 #include "multichoose.h"
 #include "TryCatch.h"
 
+static pthread_mutex_t internedNamesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+const string* internName(const string& name) {
+    pthread_mutex_lock(&internedNamesMutex);
+    // set elements never move, so their addresses serve as handles
+    static set<string> internedNames;
+    const string* interned = &*internedNames.insert(name).first;
+    pthread_mutex_unlock(&internedNamesMutex);
+    return interned;
+}
+
+const string& nameOf(const string* name) {
+    static const string none;
+    return name ? *name : none;
+}
+
 
 int Allele::referenceOffset(void) const {
     /*cout << readID << " offset checked " << referencePosition - position << " against position " << position 
@@ -10,6 +26,15 @@ int Allele::referenceOffset(void) const {
     return *currentReferencePosition - position;
 }
 
+short Allele::referenceBaseQuality(void) const {
+    int off = referenceOffset();
+    if (off < 0 || off >= (int) baseQualities.size()) {
+        return 0;
+    } else {
+        return baseQualities[off];
+    }
+}
+
 void Allele::setQuality(void) {
     quality = currentQuality();
     lnquality = phred2ln(quality);
@@ -26,6 +51,10 @@ int Allele::bpRight(void) {
 // called prior to using the allele in analysis
 // called again when haplotype alleles are built, in which case the "currentBase" is set to the alternate sequence of the allele
 void Allele::update(int haplotypeLength) {
+    if (haplotypeLength == 1 && type == ALLELE_REFERENCE) {
+        updateReferenceBase();
+        return;
+    }
     if (haplotypeLength == 1) {
         if (type == ALLELE_REFERENCE) {
             currentBase = string(1, *currentReferenceBase);
@@ -41,6 +70,20 @@ void Allele::update(int haplotypeLength) {
     basesRight = bpRight();
 }
 
+// the single-base update of a reference observation, which writes the
+// reference base in place and reads the quality of the read at that base
+// directly; see Samples::addReferenceObservations
+void Allele::updateReferenceBase(void) {
+    if (currentBase.size() != 1) {
+        currentBase.resize(1);
+    }
+    currentBase[0] = *currentReferenceBase;
+    quality = referenceBaseQuality();
+    lnquality = phred2ln(quality);
+    basesLeft = position - alignmentStart;
+    basesRight = alignmentEnd - (position + referenceLength);
+}
+
 // quality of subsequence of allele
 const int Allele::subquality(int startpos, int len) const {
     int start = startpos - position;
@@ -52,7 +95,7 @@ const int Allele::subquality(int startpos, int len) const {
 }
 
 // quality of subsequence of allele
-const long double Allele::lnsubquality(int startpos, int len) const {
+const ProbFloat Allele::lnsubquality(int startpos, int len) const {
     return phred2ln(subquality(startpos, len));
 }
 
@@ -126,7 +169,7 @@ const int Allele::subquality(const Allele &a) const {
     return sum * (l / L);
 }
 
-const long double Allele::lnsubquality(const Allele& a) const {
+const ProbFloat Allele::lnsubquality(const Allele& a) const {
     return phred2ln(subquality(a));
 }
 
@@ -164,12 +207,7 @@ const short Allele::currentQuality(void) const {
             if (currentBase.size() > 1) {
                 return averageQuality(baseQualities);
             } else {
-                int off = referenceOffset();
-                if (off < 0 || off > baseQualities.size()) {
-                    return 0;
-                } else {
-                    return baseQualities.at(off);
-                }
+                return referenceBaseQuality();
             }
             break;
         case ALLELE_INSERTION:
@@ -182,7 +220,7 @@ const short Allele::currentQuality(void) const {
     }
 }
 
-const long double Allele::lncurrentQuality(void) const {
+const ProbFloat Allele::lncurrentQuality(void) const {
     return phred2ln(currentQuality());
 }
 
@@ -301,8 +339,8 @@ string stringForAllele(const Allele &allele) {
     if (!allele.genotypeAllele) {
         out.precision(1);
         out 
-            << allele.sampleID << ":"
-            << allele.readID << ":"
+            << nameOf(allele.sampleID) << ":"
+            << nameOf(allele.readID) << ":"
             << allele.typeStr() << ":"
             << allele.cigar << ":"
             << scientific << fixed << allele.position << ":"
@@ -347,7 +385,7 @@ string json(Allele*& allele) { return allele->json(); }
 string Allele::json(void) {
     stringstream out;
     if (!genotypeAllele) {
-        out << "{\"id\":\"" << readID << "\""
+        out << "{\"id\":\"" << nameOf(readID) << "\""
             << ",\"type\":\"" << typeStr() << "\""
             << ",\"length\":" << ((type == ALLELE_REFERENCE) ? 1 : length)
             << ",\"position\":" << position 
@@ -413,8 +451,8 @@ ostream &operator<<(ostream &out, Allele &allele) {
         int prec = out.precision();
         // << &allele << ":" 
         out.precision(1);
-        out << allele.sampleID
-            << ":" << allele.readID 
+        out << nameOf(allele.sampleID)
+            << ":" << nameOf(allele.readID) 
             << ":" << allele.typeStr() 
             << ":" << allele.length 
             << ":" << allele.referenceLength
@@ -585,7 +623,7 @@ map<string, vector<Allele*> > groupAllelesBySample(list<Allele*>& alleles) {
     map<string, vector<Allele*> > groups;
     for (list<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
         Allele*& allele = *a;
-        groups[allele->sampleID].push_back(allele);
+        groups[nameOf(allele->sampleID)].push_back(allele);
     }
     return groups;
 }
@@ -602,7 +640,7 @@ vector<Allele> uniqueAlleles(list<Allele*>& alleles) {
 void groupAllelesBySample(list<Allele*>& alleles, map<string, vector<Allele*> >& groups) {
     for (list<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
         Allele*& allele = *a;
-        groups[allele->sampleID].push_back(allele);
+        groups[nameOf(allele->sampleID)].push_back(allele);
     }
 }
 
@@ -1085,8 +1123,8 @@ void Allele::subtract(
         string& subend,
         vector<pair<int, string> >& cigarStart,
         vector<pair<int, string> >& cigarEnd,
-        vector<short>& qsubstart,
-        vector<short>& qsubend
+        BaseQualities& qsubstart,
+        BaseQualities& qsubend
     ) {
 
     substart.clear();
@@ -1230,31 +1268,31 @@ void Allele::subtract(
 
 }
 
-void Allele::subtractFromStart(int bp, string& seq, vector<pair<int, string> >& cig, vector<short>& quals) {
+void Allele::subtractFromStart(int bp, string& seq, vector<pair<int, string> >& cig, BaseQualities& quals) {
     string emptystr;
     vector<pair<int, string> > emptycigar;
-    vector<short> emptyquals;
+    BaseQualities emptyquals;
     subtract(bp, 0, seq, emptystr, cig, emptycigar, quals, emptyquals);
 }
 
-void Allele::subtractFromEnd(int bp, string& seq, vector<pair<int, string> >& cig, vector<short>& quals) {
+void Allele::subtractFromEnd(int bp, string& seq, vector<pair<int, string> >& cig, BaseQualities& quals) {
     string emptystr;
     vector<pair<int, string> > emptycigar;
-    vector<short> emptyquals;
+    BaseQualities emptyquals;
     subtract(0, bp, emptystr, seq, emptycigar, cig, emptyquals, quals);
 }
 
-void Allele::addToStart(string& seq, vector<pair<int, string> >& cig, vector<short>& quals) {
+void Allele::addToStart(string& seq, vector<pair<int, string> >& cig, BaseQualities& quals) {
     string emptystr;
     vector<pair<int, string> > emptycigar;
-    vector<short> emptyquals;
+    BaseQualities emptyquals;
     add(seq, emptystr, cig, emptycigar, quals, emptyquals);
 }
 
-void Allele::addToEnd(string& seq, vector<pair<int, string> >& cig, vector<short>& quals) {
+void Allele::addToEnd(string& seq, vector<pair<int, string> >& cig, BaseQualities& quals) {
     string emptystr;
     vector<pair<int, string> > emptycigar;
-    vector<short> emptyquals;
+    BaseQualities emptyquals;
     add(emptystr, seq, emptycigar, cig, emptyquals, quals);
 }
 
@@ -1263,8 +1301,8 @@ void Allele::add(
         string& addToEnd,
         vector<pair<int, string> >& cigarStart,
         vector<pair<int, string> >& cigarEnd,
-        vector<short>& qaddToStart,
-        vector<short>& qaddToEnd
+        BaseQualities& qaddToStart,
+        BaseQualities& qaddToEnd
     ) {
 
     // adjust the position
@@ -11,6 +11,8 @@
 #include <limits>
 #include <sstream>
 #include <assert.h>
+#include <set>
+#include <pthread.h>
 #include "Utility.h"
 #include "convert.h"
 #include "api/BamAlignment.h"
@@ -20,6 +22,17 @@ using namespace BamTools;
 
 class Allele;
 
+// names carried by every observation, such as the sample and read group, are
+// interned so that each allele holds a pointer to one shared copy rather than
+// its own strings; names then compare by address
+//
+// the table is shared by all threads and only grows, so it is meant for
+// names drawn from a small set, not for read names
+const string* internName(const string& name);
+
+// the interned name, or an empty string for NULL
+const string& nameOf(const string* name);
+
 // Allele recycling allocator
 // without we spend 30% of our runtime deleting Allele instances
 
@@ -101,10 +114,10 @@ class Allele {
 public:
 
     AlleleType type;        // type of the allele, enumerated above
-    string referenceName;   // reference name, for sanity checking
+    const string* referenceName;   // reference name, for sanity checking
     string referenceSequence; // reference sequence or "" (in case of insertions)
     string alternateSequence; // alternate sequence or "" (in case of deletions and reference alleles)
-    string sequencingTechnology; // the technology used to generate this allele
+    const string* sequencingTechnology; // the technology used to generate this allele
     long int position;      // position 0-based against reference
     long int* currentReferencePosition; // pointer to the current reference position (which may be updated during the life of this allele)
     char* currentReferenceBase;  // pointer to current reference base
@@ -115,15 +128,17 @@ public:
     int basesLeft;  // these are the "updated" versions of the above
     int basesRight;
     AlleleStrand strand;          // strand, true = +, false = -
-    string sampleID;        // representative sample ID
-    string readGroupID;     // read group membership
-    string readID;          // id of the read which the allele is drawn from
-    vector<short> baseQualities;
-    long double quality;          // base quality score associated with this allele, updated every position in the case of reference alleles
-    long double lnquality;  // log version of above
+    const string* sampleID;        // representative sample ID
+    int sampleIndex;               // index of the sample in the parser's sampleNames, or -1
+    const string* readGroupID;     // read group membership
+    int readGroupIndex;            // index of the read group in the parser's table, or -1
+    const string* readID;          // id of the read which the allele is drawn from, owned by its alignment
+    BaseQualities baseQualities;
+    ProbFloat quality;          // base quality score associated with this allele, updated every position in the case of reference alleles
+    ProbFloat lnquality;  // log version of above
     string currentBase;       // current base, meant to be updated every position
     short mapQuality;       // map quality for the originating read
-    long double lnmapQuality;       // map quality for the originating read
+    ProbFloat lnmapQuality;       // map quality for the originating read
     double readMismatchRate; // per-base mismatch rate for the read
     double readIndelRate;  // only considering gaps
     double readSNPRate;    // only considering snps/mnps
@@ -139,7 +154,7 @@ public:
 
     // default constructor, for converting alignments into allele observations
     Allele(AlleleType t, 
-           string& refname,
+           const string* refname,
            long int pos, 
            long int* crefpos,
            char* crefbase,
@@ -147,19 +162,19 @@ public:
            long int rrbound,
            int bleft,
            int bright,
-           string alt,
-           string& sampleid,
-           string& readid,
-           string& readgroupid,
-           string& sqtech,
+           const string& alt,
+           const string* sampleid,
+           const string* readid,
+           const string* readgroupid,
+           const string* sqtech,
            bool strnd, 
-           long double qual,
-           string qstr, 
+           ProbFloat qual,
+           const string& qstr,
            short mapqual,
            bool ispair,
            bool ismm,
            bool isproppair,
-           string cigarstr,
+           const string& cigarstr,
            vector<Allele>* ra,
            long int bas,
            long int bae)
@@ -175,12 +190,13 @@ public:
         , currentBase(alt)
         , alternateSequence(alt)
         , sampleID(sampleid)
+        , sampleIndex(-1)
+        , readGroupIndex(-1)
         , readID(readid)
         , readGroupID(readgroupid)
         , sequencingTechnology(sqtech)
         , strand(strnd ? STRAND_FORWARD : STRAND_REVERSE)
         , quality((qual == -1) ? averageQuality(qstr) : qual) // passing -1 as quality triggers this calculation
-        , lnquality(phred2ln((qual == -1) ? averageQuality(qstr) : qual))
         , mapQuality(mapqual) 
         , lnmapQuality(phred2ln(mapqual))
         , isProperPair(isproppair)
@@ -197,6 +213,7 @@ public:
         , alignmentEnd(bae)
     {
 
+        lnquality = phred2ln(quality);
         baseQualities.resize(qstr.size()); // cache qualities
         transform(qstr.begin(), qstr.end(), baseQualities.begin(), qualityChar2ShortInt);
         referenceLength = referenceLengthFromCigar();
@@ -213,6 +230,13 @@ public:
 	   long int rrbound=0,
 	   bool gallele=true) 
         : type(t)
+        , referenceName(NULL)
+        , sequencingTechnology(NULL)
+        , sampleID(NULL)
+        , sampleIndex(-1)
+        , readGroupIndex(-1)
+        , readGroupID(NULL)
+        , readID(NULL)
         , alternateSequence(alt)
         , length(len)
         , referenceLength(reflen)
@@ -243,16 +267,18 @@ public:
     bool isComplex(void) const; // true if type == ALLELE_COMPLEX
     bool isNull(void) const; // true if type == ALLELE_NULL
     int referenceOffset(void) const;
+    short referenceBaseQuality(void) const; // the quality of the read at the current reference base
     const short currentQuality(void) const;  // for getting the quality of a given position in multi-bp alleles
-    const long double lncurrentQuality(void) const;
+    const ProbFloat lncurrentQuality(void) const;
     const int subquality(int startpos, int len) const;
-    const long double lnsubquality(int startpos, int len) const;
+    const ProbFloat lnsubquality(int startpos, int len) const;
     const int subquality(const Allele &a) const;
-    const long double lnsubquality(const Allele &a) const;
+    const ProbFloat lnsubquality(const Allele &a) const;
     //const int basesLeft(void) const; // returns the bases left within the read of the current position within the allele
     //const int basesRight(void) const; // returns the bases right within the read of the current position within the allele
     bool sameSample(Allele &other);  // if the other allele has the same sample as this one
     void update(int haplotypeLength = 1); // for reference alleles, updates currentBase and quality
+    void updateReferenceBase(void); // the single-base case of the above for reference alleles
     void setQuality(void); // sets 'current quality' for alleles
     // TODO update this to reflect different insertions (e.g. IATGC instead of I4)
     const string base(void) const;  // the 'current' base of the allele or a string describing the allele, e.g. I10 or D2
@@ -286,21 +312,21 @@ public:
             string& subend,
             vector<pair<int, string> >& cigarstart,
             vector<pair<int, string> >& cigarend,
-            vector<short>& qsubstart,
-            vector<short>& qsubend);
+            BaseQualities& qsubstart,
+            BaseQualities& qsubend);
 
     void add(string& addToStart,
             string& addToEnd,
             vector<pair<int, string> >& cigarStart,
             vector<pair<int, string> >& cigarEnd,
-            vector<short>& qaddToStart,
-            vector<short>& qaddToEnd);
+            BaseQualities& qaddToStart,
+            BaseQualities& qaddToEnd);
 
 
-    void subtractFromStart(int bp, string& seq, vector<pair<int, string> >& cig, vector<short>& quals);
-    void subtractFromEnd(int bp, string& seq, vector<pair<int, string> >& cig, vector<short>& quals);
-    void addToStart(string& seq, vector<pair<int, string> >& cig, vector<short>& quals);
-    void addToEnd(string& seq, vector<pair<int, string> >& cig, vector<short>& quals);
+    void subtractFromStart(int bp, string& seq, vector<pair<int, string> >& cig, BaseQualities& quals);
+    void subtractFromEnd(int bp, string& seq, vector<pair<int, string> >& cig, BaseQualities& quals);
+    void addToStart(string& seq, vector<pair<int, string> >& cig, BaseQualities& quals);
+    void addToEnd(string& seq, vector<pair<int, string> >& cig, BaseQualities& quals);
 
     void mergeAllele(const Allele& allele, AlleleType newType);
 
@@ -4,6 +4,7 @@
                          // see: http://stackoverflow.com/questions/36039/templates-spread-across-multiple-files
                          // http://www.cplusplus.com/doc/tutorial/templates/ "Templates and Multi-file projects"
 #include "multipermute.h"
+#include <sys/stat.h>
 
 // local helper debugging macros to improve code readability
 #define DEBUG(msg) \
@@ -94,9 +95,32 @@ void AlleleParser::openTraceFile(void) {
     }
 }
 
+// when resuming from a checkpoint, the output written before it was saved is
+// kept, and anything written after it removed
+// a file shorter than the checkpoint records has lost output it held when the
+// checkpoint was saved, and can't be resumed
+static void reopenAfterCheckpoint(ofstream& file, const string& name, long int offset) {
+    struct stat st;
+    if (stat(name.c_str(), &st) || st.st_size < offset) {
+        cerr << "ERROR(freebayes): " << name << " is shorter than the checkpoint records ("
+             << offset << " bytes), so its output can't be resumed" << endl;
+        exit(1);
+    }
+    if (truncate(name.c_str(), offset)) {
+        cerr << "ERROR(freebayes): could not truncate " << name << " to resume from checkpoint" << endl;
+        exit(1);
+    }
+    file.open(name.c_str(), ios::in | ios::out);
+    file.seekp(0, ios::end);
+}
+
 void AlleleParser::openFailedFile(void) {
     if (!parameters.failedFile.empty()) {
-        failedFile.open(parameters.failedFile.c_str(), ios::out);
+        if (checkpoint.resumed) {
+            reopenAfterCheckpoint(failedFile, parameters.failedFile, checkpoint.failedOffset);
+        } else {
+            failedFile.open(parameters.failedFile.c_str(), ios::out);
+        }
         DEBUG("Opening failed alleles file: " << parameters.failedFile << " ...");
         if (!failedFile) {
             ERROR(" unable to open failed alleles file: " << parameters.failedFile );
@@ -106,8 +130,20 @@ void AlleleParser::openFailedFile(void) {
 }
 
 void AlleleParser::openOutputFile(void) {
-    if (parameters.outputFile != "") {
-        outputFile.open(parameters.outputFile.c_str(), ios::out);
+    bgzfStream = NULL;
+    if (parameters.bgzipOutput) {
+        DEBUG("Opening compressed output file: " << parameters.outputFile << " ...");
+        if (!bgzfOutput.open(parameters.outputFile, parameters.threads)) {
+            ERROR(" unable to open output file: " << parameters.outputFile);
+            exit(1);
+        }
+        output = bgzfStream = new ostream(&bgzfOutput);
+    } else if (parameters.outputFile != "") {
+        if (checkpoint.resumed) {
+            reopenAfterCheckpoint(outputFile, parameters.outputFile, checkpoint.outputOffset);
+        } else {
+            outputFile.open(parameters.outputFile.c_str(), ios::out);
+        }
         DEBUG("Opening output file: " << parameters.outputFile << " ...");
         if (!outputFile) {
             ERROR(" unable to open output file: " << parameters.outputFile);
@@ -562,6 +598,20 @@ void AlleleParser::loadFastaReference(void) {
 
 }
 
+// reads reference sequence from the packed reference if one is given and
+// holds the sequence, otherwise from the FASTA
+void AlleleParser::referenceSubSequence(const string& seqname, long int start, long int length, string& sequence) {
+    if (!packedReference || !packedReference->getSubSequence(seqname, start, length, sequence)) {
+        reference.getSubSequence(seqname, start, length, sequence);
+    }
+}
+
+string AlleleParser::referenceSubSequence(const string& seqname, long int start, long int length) {
+    string sequence;
+    referenceSubSequence(seqname, start, length, sequence);
+    return sequence;
+}
+
 // alignment-based method for loading the first bit of our reference sequence
 void AlleleParser::loadReferenceSequence(BamAlignment& alignment) {
     DEBUG2("loading reference sequence overlapping first alignment");
@@ -569,9 +619,10 @@ void AlleleParser::loadReferenceSequence(BamAlignment& alignment) {
     rightmostHaplotypeBasisAllelePosition = currentPosition;
     currentSequenceStart = alignment.Position;
     currentSequenceName = referenceIDToName[alignment.RefID];
+    currentSequenceID = internName(currentSequenceName);
     currentRefID = alignment.RefID;
     DEBUG2("reference.getSubSequence("<< currentSequenceName << ", " << currentSequenceStart << ", " << alignment.AlignedBases.length() << ")");
-    currentSequence = uppercase(reference.getSubSequence(currentSequenceName, currentSequenceStart, alignment.Length));
+    currentSequence = uppercase(referenceSubSequence(currentSequenceName, currentSequenceStart, alignment.Length));
 }
 
 // intended to load all the sequence covered by reads which overlap our current target
@@ -582,13 +633,13 @@ void AlleleParser::loadReferenceSequence(BedTarget* target, int before, int afte
     basesAfterCurrentTarget = after;
     DEBUG2("loading reference subsequence " << target->seq << " from " << target->left << " - " << before << " to " << target->right << " + " << after << " + before");
     string name = reference.sequenceNameStartingWith(target->seq);
-    currentSequence = uppercase(reference.getSubSequence(name, (target->left - 1) - before, (target->right - target->left) + after + before));
+    currentSequence = uppercase(referenceSubSequence(name, (target->left - 1) - before, (target->right - target->left) + after + before));
     currentReferenceBase = currentReferenceBaseChar();
 }
 
 // used to extend the cached reference subsequence when we encounter a read which extends beyond its right bound
 void AlleleParser::extendReferenceSequence(int rightExtension) {
-    currentSequence += uppercase(reference.getSubSequence(reference.sequenceNameStartingWith(currentSequenceName), 
+    currentSequence += uppercase(referenceSubSequence(reference.sequenceNameStartingWith(currentSequenceName), 
                                                  currentTarget->right + basesAfterCurrentTarget,
                                                  rightExtension));
     basesAfterCurrentTarget += rightExtension;
@@ -610,13 +661,13 @@ void AlleleParser::preserveReferenceSequenceWindow(int bp) {
 
     if (leftdiff > 0) {
         //cerr << currentSequenceStart << endl;
-        string left = reference.getSubSequence(currentSequenceName, currentSequenceStart, leftdiff);
+        string left = referenceSubSequence(currentSequenceName, currentSequenceStart, leftdiff);
         currentSequence.insert(0, uppercase(left));
         currentSequenceStart -= left.size();
 
     }
     if (rightdiff > 0) {
-        currentSequence += uppercase(reference.getSubSequence(
+        currentSequence += uppercase(referenceSubSequence(
                 currentSequenceName,
                 (currentSequenceStart + currentSequence.size()),
                 rightdiff));  // always go 10bp past the end of what we need for alignment registration
@@ -629,9 +680,9 @@ void AlleleParser::extendReferenceSequence(BamAlignment& alignment) {
     int leftdiff = currentSequenceStart - alignment.Position;
     leftdiff = (currentSequenceStart - leftdiff < 0) ? currentSequenceStart : leftdiff;
     if (leftdiff > 0) {
-        string left = reference.getSubSequence(currentSequenceName,
-                                               currentSequenceStart,
-                                               leftdiff);
+        string left = referenceSubSequence(currentSequenceName,
+                                           currentSequenceStart,
+                                           leftdiff);
         currentSequenceStart -= left.size();
         if (currentSequenceStart < 0) currentSequenceStart = 0;
         currentSequence.insert(0, uppercase(left));
@@ -641,10 +692,13 @@ void AlleleParser::extendReferenceSequence(BamAlignment& alignment) {
         (alignment.Position + alignment.AlignedBases.size())
         - (currentSequenceStart + currentSequence.size());
     if (rightdiff > 0) {
-        currentSequence += uppercase(reference.getSubSequence(
-                                         currentSequenceName,
-                                         (currentSequenceStart + currentSequence.size()),
-                                         rightdiff));
+        // this happens for most alignments, so the read goes through a reused buffer
+        referenceSubSequence(currentSequenceName,
+                             (currentSequenceStart + currentSequence.size()),
+                             rightdiff,
+                             referenceExtension);
+        transform(referenceExtension.begin(), referenceExtension.end(), referenceExtension.begin(), upper);
+        currentSequence += referenceExtension;
     }
 }
 
@@ -801,10 +855,48 @@ int AlleleParser::currentSamplePloidy(string const& sample) {
     return sampleCNV.ploidy(sample, currentSequenceName, currentPosition);
 }
 
+// resolves each read group of the headers to its sample and technology
+// the index of a read group depends only on the headers, so it is the same in
+// every parser built from the same input
+// samples of the read groups which are not in the sample list are still
+// observed, so they are indexed after it, and the reference sample last
+void AlleleParser::indexReadGroups(void) {
+    readGroups.clear();
+    readGroupIndexes.clear();
+    sampleNames = sampleList;
+    for (map<string, string>::iterator s = readGroupToSampleNames.begin(); s != readGroupToSampleNames.end(); ++s) {
+        const string& readGroup = s->first;
+        vector<string>::iterator n = find(sampleNames.begin(), sampleNames.end(), s->second);
+        if (n == sampleNames.end()) {
+            n = sampleNames.insert(sampleNames.end(), s->second);
+        }
+        int sampleIndex = n - sampleNames.begin();
+        const string* technology = internName("");
+        map<string, string>::iterator t = readGroupToTechnology.find(readGroup);
+        if (t != readGroupToTechnology.end()) {
+            technology = internName(t->second);
+        }
+        readGroupIndexes[readGroup] = readGroups.size();
+        readGroups.push_back(ReadGroup(internName(readGroup), internName(s->second), technology, sampleIndex));
+    }
+    referenceSampleIndex = sampleNames.size();
+    sampleNames.push_back(referenceSampleName);
+}
+
+// the index of the read group in readGroups, or -1 if the headers do not list it
+int AlleleParser::readGroupIndex(const string& readGroup) {
+    map<string, int>::iterator i = readGroupIndexes.find(readGroup);
+    if (i != readGroupIndexes.end()) {
+        return i->second;
+    } else {
+        return -1;
+    }
+}
+
 int AlleleParser::copiesOfLocus(Samples& samples) {
     int copies = 0;
     for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-        string const& name = s->first;
+        string const& name = (*s)->name;
         copies += currentSamplePloidy(name);
     }
     return copies;
@@ -814,7 +906,7 @@ vector<int> AlleleParser::currentPloidies(Samples& samples) {
     map<int, bool> ploidiesMap;
     vector<int> ploidies;
     for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-        string const& name = s->first;
+        string const& name = (*s)->name;
         int samplePloidy = currentSamplePloidy(name);
         ploidiesMap[samplePloidy] = true;
     }
@@ -826,8 +918,10 @@ vector<int> AlleleParser::currentPloidies(Samples& samples) {
 }
 
 // meant to be used when we are reading from stdin, to check if we are within targets
+// the bed reader holds every target, even if targets has been narrowed to a
+// single work unit via setTarget
 bool AlleleParser::inTarget(void) {
-    if (targets.empty()) {
+    if (bedReader.targets.empty()) {
         return true;  // everything is in target if we don't have targets
     } else {
         if (bedReader.targetsOverlap(currentSequenceName, currentPosition, currentPosition + 1)) {
@@ -840,18 +934,55 @@ bool AlleleParser::inTarget(void) {
 
 // initialization function
 // sets up environment so we can start registering alleles
-AlleleParser::AlleleParser(int argc, char** argv) : parameters(Parameters(argc, argv))
+AlleleParser::AlleleParser(int argc, char** argv)
+    : parameters(Parameters(argc, argv))
+    , alignmentPrefetcher(bamMultiReader)
 {
 
+    if (!parameters.checkpointFile.empty()) {
+        checkpoint.load(parameters.checkpointFile);
+        checkpoint.outputFile = parameters.outputFile;
+        checkpoint.failedFile = parameters.failedFile;
+    }
+
+    // output files
+    openTraceFile();
+    openFailedFile();
+    openOutputFile();
+
+    initialize();
+
+}
+
+// sets up a parser for a worker thread
+// workers share the parameters of the parser built from the command line, but
+// they do not open any output files, as their results are written by the caller
+AlleleParser::AlleleParser(const Parameters& params)
+    : parameters(params)
+    , alignmentPrefetcher(bamMultiReader)
+{
+
+    output = NULL;
+    bgzfStream = NULL;
+
+    initialize();
+
+}
+
+void AlleleParser::initialize(void) {
+
     oneSampleAnalysis = false;
     currentRefID = 0; // will get set properly via toNextRefID
     currentPosition = 0;
     currentTarget = NULL; // to be initialized on first call to getNextAlleles
+    currentSequenceID = NULL;
+    packedReference = NULL;
     currentReferenceAllele = NULL; // same, NULL is brazenly used as an initialization flag
     justSwitchedTargets = false;  // flag to trigger cleanup of Allele*'s and objects after jumping targets
     hasMoreAlignments = true; // flag to track when we run out of alignments in the current target or BAM files
     currentSequenceStart = 0;
     lastHaplotypeLength = 0;
+    skipUninformativePositions = false;
     usingHaplotypeBasisAlleles = false;
     usingVariantInputAlleles = false;
     rightmostHaplotypeBasisAllelePosition = 0;
@@ -860,10 +991,6 @@ AlleleParser::AlleleParser(int argc, char** argv) : parameters(Parameters(argc,
     referenceSampleName = "reference_sample";
 
     // initialization
-    openTraceFile();
-    openFailedFile();
-    openOutputFile();
-
     loadFastaReference();
     // when we open the bam files we can use the number of targets to decide if
     // we should load the indexes
@@ -874,6 +1001,7 @@ AlleleParser::AlleleParser(int argc, char** argv) : parameters(Parameters(argc,
     getSampleNames();
     getPopulations();
     getSequencingTechnologies();
+    indexReadGroups();
 
     // sample CNV
     loadSampleCNVMap();
@@ -893,6 +1021,13 @@ AlleleParser::~AlleleParser(void) {
 
     delete nullSample;
 
+    // compressed output is only complete once its last blocks and index are written
+    if (bgzfStream) {
+        bgzfStream->flush();
+        bgzfOutput.close();
+        delete bgzfStream;
+    }
+
     // close trace file?  seems to get closed properly on object deletion...
     if (currentReferenceAllele) delete currentReferenceAllele;
 
@@ -927,7 +1062,7 @@ string AlleleParser::currentReferenceHaplotype(void) {
 }
 
 string AlleleParser::referenceSubstr(long int pos, unsigned int len) {
-    return uppercase(reference.getSubSequence(currentSequenceName, floor(pos), len));
+    return uppercase(referenceSubSequence(currentSequenceName, floor(pos), len));
 }
 
 bool AlleleParser::isCpG(string& altbase) {
@@ -1000,7 +1135,7 @@ void RegisteredAlignment::addAllele(Allele newAllele, bool mergeComplex, int max
             // do nothing
         } else if (newAllele.isReference() && isUnflankedIndel(lastAllele)) {
             // add flanking base to indel, ensuring haplotype length of 2 for all indels
-            string seq; vector<pair<int, string> > cig; vector<short> quals;
+            string seq; vector<pair<int, string> > cig; BaseQualities quals;
             //cerr << "subtracting from start " << newAllele << " giving to " << lastAllele << endl;
             newAllele.subtractFromStart(1, seq, cig, quals);
             lastAllele.addToEnd(seq, cig, quals);
@@ -1026,7 +1161,7 @@ void RegisteredAlignment::addAllele(Allele newAllele, bool mergeComplex, int max
                         // break apart the complex allele
                         alleles.push_back(lastAllele);
                         Allele& pAllele = alleles.at(alleles.size() - 2);
-                        string seq; vector<pair<int, string> > cig; vector<short> quals;
+                        string seq; vector<pair<int, string> > cig; BaseQualities quals;
                         pAllele.subtractFromEnd(matchlen, seq, cig, quals);
                         alleles.back().subtractFromStart(pAllele.referenceLength, seq, cig, quals);
                         alleles.back().mergeAllele(newAllele, ALLELE_REFERENCE);
@@ -1044,7 +1179,7 @@ void RegisteredAlignment::addAllele(Allele newAllele, bool mergeComplex, int max
                 alleles.push_back(newAllele);
             } else if (newAllele.isInsertion() || newAllele.isDeletion()) {
                 int p = newAllele.position - 1;
-                string seq; vector<pair<int, string> > cig; vector<short> quals;
+                string seq; vector<pair<int, string> > cig; BaseQualities quals;
                 lastAllele.subtractFromEnd(1, seq, cig, quals);
                 if (lastAllele.length == 0) {
                     alleles.pop_back(); // remove 0-length alleles
@@ -1067,7 +1202,7 @@ void RegisteredAlignment::addAllele(Allele newAllele, bool mergeComplex, int max
                     int matchlen = cigar.back().first;
                     alleles.push_back(lastAllele);
                     Allele& pAllele = alleles.at(alleles.size() - 2);
-                    string seq; vector<pair<int, string> > cig; vector<short> quals;
+                    string seq; vector<pair<int, string> > cig; BaseQualities quals;
                     pAllele.subtractFromEnd(matchlen, seq, cig, quals);
                     alleles.back().subtractFromStart(pAllele.referenceLength, seq, cig, quals);
                 }
@@ -1172,10 +1307,10 @@ Allele AlleleParser::makeAllele(RegisteredAlignment& ra,
                                 int basesLeft,
                                 int basesRight,
                                 string& readSequence,
-                                string& sampleName,
+                                const string* sampleName,
                                 BamAlignment& alignment,
-                                string& sequencingTech,
-                                long double qual,
+                                const string* sequencingTech,
+                                ProbFloat qual,
                                 string& qualstr
     ) {
 
@@ -1296,8 +1431,8 @@ Allele AlleleParser::makeAllele(RegisteredAlignment& ra,
         }
     }
 
-    return Allele(type,
-                  currentSequenceName,
+    Allele allele(type,
+                  currentSequenceID,
                   pos,
                   &currentPosition,
                   &currentReferenceBase,
@@ -1307,11 +1442,11 @@ Allele AlleleParser::makeAllele(RegisteredAlignment& ra,
                   basesRight,
                   readSequence,
                   sampleName,
-                  alignment.Name,
-                  ra.readgroup,
+                  &ra.name,
+                  ra.readGroupID,
                   sequencingTech,
                   !alignment.IsReverseStrand(),
-                  max(qual, (long double) 0), // ensure qual is at least 0
+                  max(qual, (ProbFloat) 0), // ensure qual is at least 0
                   qualstr,
                   alignment.MapQuality,
                   alignment.IsPaired(),
@@ -1321,13 +1456,17 @@ Allele AlleleParser::makeAllele(RegisteredAlignment& ra,
                   &ra.alleles,
                   alignment.Position,
                   alignment.GetEndPosition());
+    allele.sampleIndex = ra.sampleIndex;
+    allele.readGroupIndex = ra.readGroupIndex;
+    return allele;
 
 }
 
-RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, RegisteredAlignment& ra, string& sampleName, string& sequencingTech) {
+RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, RegisteredAlignment& ra, const string* sampleName, const string* sequencingTech) {
 
-    string rDna = alignment.QueryBases;
-    string rQual = alignment.Qualities;
+    // the read's bases and qualities are only read, so refer to them in place
+    const string& rDna = alignment.QueryBases;
+    const string& rQual = alignment.Qualities;
     int rp = 0;  // read position, 0-based relative to read
     int csp = currentSequencePosition(alignment); // current sequence position, 0-based relative to currentSequence
     int sp = alignment.Position;  // sequence position
@@ -1417,7 +1556,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
             for (int i=0; i<l; i++) {
 
                 // extract aligned base
-                string b;
+                char b;
                 try {
                     b = rDna.at(rp);
                 } catch (std::out_of_range outOfRange) {
@@ -1430,10 +1569,10 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
                 }
 
                 // convert base quality value into short int
-                long double qual = qualityChar2LongDouble(rQual.at(rp));
+                ProbFloat qual = qualityChar2LongDouble(rQual.at(rp));
 
                 // get reference allele
-                string sb;
+                char sb;
                 try {
                     sb = currentSequence.at(csp);
                 } catch (std::out_of_range outOfRange) {
@@ -1448,7 +1587,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
                 }
 
                 // record mismatch if we have a mismatch here
-                if (b != sb || sb == "N") {  // when the reference is N, we should always call a mismatch
+                if (b != sb || sb == 'N') {  // when the reference is N, we should always call a mismatch
                     if (firstMatch < csp) {
                         int length = csp - firstMatch;
                         string readSequence = rDna.substr(rp - length, length);
@@ -1494,7 +1633,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
                     string readSequence = rDna.substr(rp - length, length);
                     string qualstr = rQual.substr(rp - length, length);
                     for (int j = 0; j < length; ++j) {
-                        long double lqual = qualityChar2LongDouble(qualstr.at(j));
+                        ProbFloat lqual = qualityChar2LongDouble(qualstr.at(j));
                         string qualp = qualstr.substr(j, 1);
                         string rs = readSequence.substr(j, 1);
                         if (allATGC(rs)) {
@@ -1544,7 +1683,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
                 string readSequence = rDna.substr(rp - length, length);
                 string qualstr = rQual.substr(rp - length, length);
                 for (int j = 0; j < length; ++j) {
-                    long double lqual = qualityChar2LongDouble(qualstr.at(j));
+                    ProbFloat lqual = qualityChar2LongDouble(qualstr.at(j));
                     string qualp = qualstr.substr(j, 1);
                     string rs = readSequence.substr(j, 1);
                     if (allATGC(rs)) {
@@ -1635,7 +1774,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
 
             string qualstr = rQual.substr(spanstart, L);
 
-            long double qual;
+            ProbFloat qual;
             if (parameters.useMinIndelQuality) {
                 qual = minQuality(qualstr);
                 //qual = averageQuality(qualstr);
@@ -1648,8 +1787,8 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
                 // the quality string X a scaling constant derived from the ratio
                 // between the length of the quality string and the length of the
                 // allele
-                //qual += ln2phred(log((long double) l / (long double) L));
-                qual += ln2phred(log((long double) L / (long double) l));
+                //qual += ln2phred(log((ProbFloat) l / (ProbFloat) L));
+                qual += ln2phred(log((ProbFloat) L / (ProbFloat) l));
                 qual /= harmonicSum(l);
             }
 
@@ -1716,7 +1855,7 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
 
             string qualstr = rQual.substr(spanstart, L);
 
-            long double qual;
+            ProbFloat qual;
             if (parameters.useMinIndelQuality) {
                 qual = minQuality(qualstr);
                 //qual = averageQuality(qualstr); // does not work as well as the min
@@ -1729,8 +1868,8 @@ RegisteredAlignment& AlleleParser::registerAlignment(BamAlignment& alignment, Re
                 // the quality string X a scaling constant derived from the ratio
                 // between the length of the quality string and the length of the
                 // allele
-                //qual += ln2phred(log((long double) l / (long double) L));
-                qual += ln2phred(log((long double) L / (long double) l));
+                //qual += ln2phred(log((ProbFloat) l / (ProbFloat) L));
+                qual += ln2phred(log((ProbFloat) L / (ProbFloat) l));
                 qual /= harmonicSum(l);
             }
 
@@ -1927,11 +2066,11 @@ void AlleleParser::updateAlignmentQueue(long int position,
     if (hasMoreAlignments
         && currentAlignment.Position <= position
         && currentAlignment.RefID == currentRefID) {
+        string readGroup; // reused across alignments
         do {
             DEBUG2("top of alignment parsing loop");
             DEBUG2("currentAlignment.Name == " << currentAlignment.Name);
             // get read group, and map back to a sample name
-            string readGroup;
             if (!currentAlignment.GetTag("RG", readGroup)) {
                 if (!oneSampleAnalysis) {
                     ERROR("Couldn't find read group id (@RG tag) for BAM Alignment " <<
@@ -1951,7 +2090,8 @@ void AlleleParser::updateAlignmentQueue(long int position,
             }
 
             // skip this alignment if we are not analyzing the sample it is drawn from
-            if (readGroupToSampleNames.find(readGroup) == readGroupToSampleNames.end()) {
+            int rgIndex = readGroupIndex(readGroup);
+            if (rgIndex < 0) {
                 ERROR("could not find sample matching read group id " << readGroup);
                 continue;
             }
@@ -2000,24 +2140,17 @@ void AlleleParser::updateAlignmentQueue(long int position,
                     stablyLeftAlign(currentAlignment,
                                     currentSequence.substr(currentSequencePosition(currentAlignment), length));
                 }
-                // get sample name
-                string sampleName = readGroupToSampleNames[readGroup];
-                string sequencingTech;
-                map<string, string>::iterator t = readGroupToTechnology.find(readGroup);
-                if (t != readGroupToTechnology.end()) {
-                    sequencingTech = t->second;
-                }
+                // the sample and technology of the read group, shared with the alignment's alleles
+                ReadGroup& rg = readGroups[rgIndex];
                 // limit base quality if cap set
                 if (parameters.baseQualityCap != 0) {
                     capBaseQuality(currentAlignment, parameters.baseQualityCap);
                 }
                 // decomposes alignment into a set of alleles
-                // here we get the deque of alignments ending at this alignment's end position
-                deque<RegisteredAlignment>& rq = registeredAlignments[currentAlignment.GetEndPosition()];
-                // and insert the registered alignment into that deque
-                rq.push_front(RegisteredAlignment(currentAlignment));
-                RegisteredAlignment& ra = rq.front();
-                registerAlignment(currentAlignment, ra, sampleName, sequencingTech);
+                // registers the alignment with those ending at its end position
+                RegisteredAlignment& ra = registeredAlignments.push(currentAlignment);
+                ra.setReadGroup(rgIndex, rg);
+                registerAlignment(currentAlignment, ra, rg.sample, rg.technology);
                 // backtracking if we have too many mismatches
                 // or if there are no recorded alleles
                 if (ra.alleles.empty()
@@ -2025,7 +2158,7 @@ void AlleleParser::updateAlignmentQueue(long int position,
                     || ra.mismatches > parameters.RMU
                     || ra.snpCount > parameters.readSnpLimit
                     || ra.indelCount > parameters.readIndelLimit) {
-                    rq.pop_front(); // backtrack
+                    registeredAlignments.popLast(); // backtrack
                 } else {
                     // push the alleles into our new alleles vector
                     for (vector<Allele>::iterator allele = ra.alleles.begin(); allele != ra.alleles.end(); ++allele) {
@@ -2033,7 +2166,7 @@ void AlleleParser::updateAlignmentQueue(long int position,
                     }
                 }
             }
-        } while ((hasMoreAlignments = bamMultiReader.GetNextAlignment(currentAlignment))
+        } while ((hasMoreAlignments = alignmentPrefetcher.GetNextAlignment(currentAlignment))
                  && currentAlignment.Position <= position
                  && currentAlignment.RefID == currentRefID);
     }
@@ -2048,31 +2181,15 @@ void AlleleParser::addToRegisteredAlleles(vector<Allele*>& alleles) {
                              alleles.end());
 }
 
-// updates registered alleles and erases the unused portion of our cached reference sequence
+// erases the unused portion of our cached reference sequence
+// registered alleles which have been passed are dropped as the queue advances
 void AlleleParser::updateRegisteredAlleles(void) {
 
-    long int lowestPosition = currentSequenceStart + currentSequence.size();
-
-    // remove reference alleles which are no longer overlapping the current position
-    // http://stackoverflow.com/questions/347441/erasing-elements-from-a-vector
-    vector<Allele*>& alleles = registeredAlleles;
-
-
-    for (vector<Allele*>::iterator allele = alleles.begin(); allele != alleles.end(); ++allele) {
-        long unsigned int position = (*allele)->position;
-        // note that this will underflow if currentPosition == 0 and lastHaplotypeLength > 0
-        // resolved by setting lastHaplotypeLength = 0 in init, and when we switch targets
-        if (currentPosition - lastHaplotypeLength > position + (*allele)->referenceLength) {
-            *allele = NULL;
-        }
-        else {
-            if (position < lowestPosition)
-                lowestPosition = position;
-        }
+    long int lowestPosition = registeredAlleleQueue.lowestPosition();
+    if (lowestPosition < 0) {
+        lowestPosition = currentSequenceStart + currentSequence.size();
     }
 
-    alleles.erase(remove(alleles.begin(), alleles.end(), (Allele*)NULL), alleles.end());
-
     if (lowestPosition <= currentPosition) {
         int diff = lowestPosition - currentSequenceStart;
         // do we have excess bases beyond the current lowest position - cached_reference_window?
@@ -2166,9 +2283,9 @@ void AlleleParser::updateInputVariants(long int pos, int referenceLength) {
                             allelePos -= 1;
                             reflen = len + 2;
                             alleleSequence =
-                                uppercase(reference.getSubSequence(currentSequenceName, allelePos, 1))
+                                uppercase(referenceSubSequence(currentSequenceName, allelePos, 1))
                                 + alleleSequence
-                                + uppercase(reference.getSubSequence(currentSequenceName, allelePos+1+len, 1));
+                                + uppercase(referenceSubSequence(currentSequenceName, allelePos+1+len, 1));
                             cigar = "1M" + convert(len) + "D" + "1M";
                         } else {
                             // we always include the flanking bases for these elsewhere, so here too in order to be consistent and trigger use
@@ -2176,9 +2293,9 @@ void AlleleParser::updateInputVariants(long int pos, int referenceLength) {
                             // add previous base and post base to match format typically used for calling
                             allelePos -= 1;
                             alleleSequence =
-                                uppercase(reference.getSubSequence(currentSequenceName, allelePos, 1))
+                                uppercase(referenceSubSequence(currentSequenceName, allelePos, 1))
                                 + alleleSequence
-                                + uppercase(reference.getSubSequence(currentSequenceName, allelePos+1, 1));
+                                + uppercase(referenceSubSequence(currentSequenceName, allelePos+1, 1));
                             len = variant.alt.size() - var.ref.size();
                             cigar = "1M" + convert(len) + "I" + "1M";
                             reflen = 2;
@@ -2296,7 +2413,7 @@ void AlleleParser::updateInputVariants(long int pos, int referenceLength) {
                         // in the case that we have genotype likelihoods in the VCF
                         if (sample.find("GL") != sample.end()) {
                             vector<string>& gls = sample["GL"];
-                            vector<long double> genotypeLikelihoods;
+                            vector<ProbFloat> genotypeLikelihoods;
                             genotypeLikelihoods.resize(gls.size());
                             transform(gls.begin(), gls.end(), genotypeLikelihoods.begin(), log10string2ln);
 
@@ -2305,7 +2422,7 @@ void AlleleParser::updateInputVariants(long int pos, int referenceLength) {
                             for (map<Genotype*, int>::iterator gto = genotypeOrder.begin(); gto != genotypeOrder.end(); ++gto) {
                                 Genotype& genotype = *gto->first;
                                 int order = gto->second;
-                                map<string, long double>& sampleGenotypeLikelihoods = inputGenotypeLikelihoods[alternatePosition][sampleName];
+                                map<string, ProbFloat>& sampleGenotypeLikelihoods = inputGenotypeLikelihoods[alternatePosition][sampleName];
                                 //cerr << sampleName << ":" << convert(genotype) << ":" << genotypeLikelihoods[order] << endl;
                                 sampleGenotypeLikelihoods[convert(genotype)] = genotypeLikelihoods[order];
                             }
@@ -2348,7 +2465,7 @@ void AlleleParser::addCurrentGenotypeLikelihoods(map<int, vector<Genotype> >& ge
     // check if there are any genotype likelihoods at the current position
     if (inputGenotypeLikelihoods.find(currentPosition) != inputGenotypeLikelihoods.end()) {
 
-        map<string, map<string, long double> >& inputLikelihoodsBySample = inputGenotypeLikelihoods[currentPosition];
+        map<string, map<string, ProbFloat> >& inputLikelihoodsBySample = inputGenotypeLikelihoods[currentPosition];
 
         vector<Genotype*> genotypePtrs;
         for (map<int, vector<Genotype> >::iterator gp = genotypesByPloidy.begin(); gp != genotypesByPloidy.end(); ++gp) {
@@ -2358,14 +2475,14 @@ void AlleleParser::addCurrentGenotypeLikelihoods(map<int, vector<Genotype> >& ge
             }
         }
         // if there are, add them to the sample data likelihoods
-        for (map<string, map<string, long double> >::iterator gls = inputLikelihoodsBySample.begin();
+        for (map<string, map<string, ProbFloat> >::iterator gls = inputLikelihoodsBySample.begin();
                 gls != inputLikelihoodsBySample.end(); ++gls) {
             const string& sampleName = gls->first;
-            map<string, long double>& likelihoods = gls->second;
-            map<Genotype*, long double> likelihoodsPtr;
-            for (map<string, long double>::iterator gl = likelihoods.begin(); gl != likelihoods.end(); ++gl) {
+            map<string, ProbFloat>& likelihoods = gls->second;
+            map<Genotype*, ProbFloat> likelihoodsPtr;
+            for (map<string, ProbFloat>::iterator gl = likelihoods.begin(); gl != likelihoods.end(); ++gl) {
                 const string& genotype = gl->first;
-                long double l = gl->second;
+                ProbFloat l = gl->second;
                 for (vector<Genotype*>::iterator g = genotypePtrs.begin(); g != genotypePtrs.end(); ++g) {
                     if (convert(**g) == genotype) {
                         likelihoodsPtr[*g] = l;
@@ -2377,7 +2494,7 @@ void AlleleParser::addCurrentGenotypeLikelihoods(map<int, vector<Genotype> >& ge
             sampleData.name = sampleName;
             // TODO add null sample object to sampleData
             // do you need to????
-            for (map<Genotype*, long double>::iterator p = likelihoodsPtr.begin(); p != likelihoodsPtr.end(); ++p) {
+            for (map<Genotype*, ProbFloat>::iterator p = likelihoodsPtr.begin(); p != likelihoodsPtr.end(); ++p) {
                 sampleData.push_back(SampleDataLikelihood(sampleName, nullSample, p->first, p->second, 0));
             }
             sortSampleDataLikelihoods(sampleData);
@@ -2576,9 +2693,10 @@ bool AlleleParser::toNextTarget(void) {
             clearRegisteredAlignments();
             currentSequenceStart = currentAlignment.Position;
             currentSequenceName = referenceIDToName[currentAlignment.RefID];
+            currentSequenceID = internName(currentSequenceName);
             currentRefID = currentAlignment.RefID;
             currentPosition = (currentPosition < currentAlignment.Position) ? currentAlignment.Position : currentPosition;
-            currentSequence = uppercase(reference.getSubSequence(currentSequenceName, currentSequenceStart, currentAlignment.Length));
+            currentSequence = uppercase(referenceSubSequence(currentSequenceName, currentSequenceStart, currentAlignment.Length));
             rightmostHaplotypeBasisAllelePosition = currentPosition;
 
         } else {
@@ -2632,6 +2750,7 @@ bool AlleleParser::loadTarget(BedTarget* target) {
     DEBUG2("loading target reference subsequence");
 
     currentSequenceName = currentTarget->seq;
+    currentSequenceID = internName(currentSequenceName);
 
     int refSeqID = bamMultiReader.GetReferenceID(currentSequenceName);
 
@@ -2641,7 +2760,7 @@ bool AlleleParser::loadTarget(BedTarget* target) {
     currentPosition = currentTarget->left;
     rightmostHaplotypeBasisAllelePosition = currentTarget->left;
 
-    if (!bamMultiReader.SetRegion(refSeqID, currentTarget->left, refSeqID, currentTarget->right - 1)) {  // TODO is bamtools taking 0/1 basing?
+    if (!alignmentPrefetcher.SetRegion(refSeqID, currentTarget->left, refSeqID, currentTarget->right - 1)) {  // TODO is bamtools taking 0/1 basing?
         ERROR("Could not SetRegion to " << currentTarget->seq << ":" << currentTarget->left << ".." << currentTarget->right);
         cerr << bamMultiReader.GetErrorString() << endl;
         return false;
@@ -2674,11 +2793,11 @@ bool AlleleParser::loadTarget(BedTarget* target) {
 bool AlleleParser::getFirstAlignment(void) {
 
     bool hasAlignments = true;
-    if (!bamMultiReader.GetNextAlignment(currentAlignment)) {
+    if (!alignmentPrefetcher.GetNextAlignment(currentAlignment)) {
         hasAlignments = false;
     } else {
         while (!currentAlignment.IsMapped()) {
-            if (!bamMultiReader.GetNextAlignment(currentAlignment)) {
+            if (!alignmentPrefetcher.GetNextAlignment(currentAlignment)) {
                 hasAlignments = false;
                 break;
             }
@@ -2721,10 +2840,33 @@ bool AlleleParser::getFirstVariant(void) {
 
 }
 
+// restricts processing to the given target, and resets the parser so that
+// the next call to getNextAlleles begins at its left bound
+// used to reuse one parser for many work units when running with --threads
+void AlleleParser::setTarget(const BedTarget& target) {
+    targets.clear();
+    targets.push_back(target);
+    currentTarget = NULL;
+    currentSequenceName.clear(); // triggers toNextTarget in toNextPosition
+    currentPosition = 0;
+    lastHaplotypeLength = 0;
+    justSwitchedTargets = false;
+    hasMoreVariants = false;
+    rightmostHaplotypeBasisAllelePosition = 0;
+    rightmostInputAllelePosition = 0;
+    clearRegisteredAlignments();
+    inputVariantAlleles.clear();
+    inputGenotypeLikelihoods.clear();
+    inputAlleleCounts.clear();
+    haplotypeBasisAlleles.clear();
+    cachedRepeatCounts.clear();
+}
+
 void AlleleParser::clearRegisteredAlignments(void) {
     DEBUG2("clearing registered alignments and alleles");
     registeredAlignments.clear();
     registeredAlleles.clear();
+    registeredAlleleQueue.clear();
 }
 
 // TODO
@@ -2749,6 +2891,12 @@ void AlleleParser::clearRegisteredAlignments(void) {
 // seek to next target which is in-bounds for its sequence
 // if none exist, return false
 //
+// erases the entries of a position-keyed map which lie before the position
+template <class T>
+static void erasePositionsBefore(map<long int, T>& m, long int position) {
+    m.erase(m.begin(), m.lower_bound(position));
+}
+
 bool AlleleParser::toNextPosition(void) {
 
     // either bail out
@@ -2784,7 +2932,7 @@ bool AlleleParser::toNextPosition(void) {
         // here we loop over unaligned reads at the beginning of a target
         // we need to get to a mapped read to figure out where we are
         while (hasMoreAlignments && !currentAlignment.IsMapped()) {
-            hasMoreAlignments = bamMultiReader.GetNextAlignment(currentAlignment);
+            hasMoreAlignments = alignmentPrefetcher.GetNextAlignment(currentAlignment);
         }
         // now, if the current position of this alignment is outside of the reference sequence length, switch references
         if (hasMoreAlignments) {
@@ -2815,9 +2963,12 @@ bool AlleleParser::toNextPosition(void) {
     // handle the case in which we don't have targets but in which we've switched reference sequence
 
     DEBUG2("processing position " << (long unsigned int) currentPosition + 1 << " in sequence " << currentSequenceName);
+    // step the queue first, so that alleles of newly registered alignments
+    // are placed against the current position
+    registeredAlleleQueue.advance(currentPosition);
     vector<Allele*> newAlleles;
     updateAlignmentQueue(currentPosition, newAlleles);
-    addToRegisteredAlleles(newAlleles);
+    registeredAlleleQueue.add(newAlleles);
     DEBUG2("updating variants");
     // done typically at each new read, but this handles the case where there is no data for a while
     updateInputVariants(currentPosition, 1);
@@ -2830,48 +2981,24 @@ bool AlleleParser::toNextPosition(void) {
     // if we have alignments which ended at the previous base, erase them and their alleles
     // TODO check that this doesn't leak...
     DEBUG2("erasing old registered alignments");
-    map<long unsigned int, deque<RegisteredAlignment> >::iterator f = registeredAlignments.begin();
-    while (f != registeredAlignments.end()
-           && f->first < currentPosition - lastHaplotypeLength) {
-        registeredAlignments.erase(f++);
-    }
-
-    // remove past registered alleles
-    DEBUG2("marking previous alleles as processed and removing from registered alleles");
-    removePreviousAlleles(registeredAlleles);
-    sort(registeredAlleles.begin(), registeredAlleles.end());
-    registeredAlleles.erase(unique(registeredAlleles.begin(), registeredAlleles.end()), registeredAlleles.end());
+    registeredAlignments.eraseBefore(currentPosition - lastHaplotypeLength);
 
     // and do the same for the variants from the input VCF
+    // positions may be skipped, so everything behind the window goes
     DEBUG2("erasing old input variant alleles");
-    map<long int, vector<Allele> >::iterator v = inputVariantAlleles.find(currentPosition - 3);
-    if (v != inputVariantAlleles.end()) {
-        inputVariantAlleles.erase(v);
-    }
+    erasePositionsBefore(inputVariantAlleles, currentPosition - 2);
 
     DEBUG2("erasing old input haplotype basis alleles");
-    map<long int, vector<AllelicPrimitive> >::iterator z = haplotypeBasisAlleles.find(currentPosition - 3);
-    if (z != haplotypeBasisAlleles.end()) {
-        haplotypeBasisAlleles.erase(z);
-    }
+    erasePositionsBefore(haplotypeBasisAlleles, currentPosition - 2);
 
     DEBUG2("erasing old genotype likelihoods");
-    map<long int, map<string, map<string, long double> > >::iterator l = inputGenotypeLikelihoods.find(currentPosition - 3);
-    if (l != inputGenotypeLikelihoods.end()) {
-        inputGenotypeLikelihoods.erase(l);
-    }
+    erasePositionsBefore(inputGenotypeLikelihoods, currentPosition - 2);
 
     DEBUG2("erasing old allele frequencies");
-    map<long int, map<Allele, int> >::iterator af = inputAlleleCounts.find(currentPosition - 3);
-    if (af != inputAlleleCounts.end()) {
-        inputAlleleCounts.erase(af);
-    }
+    erasePositionsBefore(inputAlleleCounts, currentPosition - 2);
 
     DEBUG2("erasing old cached repeat counts");
-    map<long int, map<string, int> >::iterator rc = cachedRepeatCounts.find(currentPosition - 3);
-    if (rc != cachedRepeatCounts.end()) {
-        cachedRepeatCounts.erase(rc);
-    }
+    erasePositionsBefore(cachedRepeatCounts, currentPosition - 2);
 
     return true;
 
@@ -2885,7 +3012,7 @@ bool AlleleParser::dummyProcessNextTarget(void) {
         return false;
     }
 
-    while (bamMultiReader.GetNextAlignment(currentAlignment)) {
+    while (alignmentPrefetcher.GetNextAlignment(currentAlignment)) {
     }
 
     return true;
@@ -2974,7 +3101,7 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
 
         string seq;
         vector<pair<int, string> > cigar;
-        vector<short> quals;
+        BaseQualities quals;
 
         // now "a" should overlap the start of the haplotype block, and "b" the end
         //cerr << "block start overlaps: " << *a << endl;
@@ -3079,6 +3206,140 @@ bool RegisteredAlignment::fitHaplotype(int haplotypeStart, int haplotypeLength,
 
 }
 
+RegisteredAlignment& RegisteredAlignments::push(BamAlignment& alignment) {
+    long int end = alignment.GetEndPosition();
+    reserve(end);
+    RegisteredAlignmentGroup*& group = slots[slot(end)];
+    if (!group) {
+        if (spareGroups.empty()) {
+            group = new RegisteredAlignmentGroup;
+        } else {
+            group = spareGroups.back();
+            spareGroups.pop_back();
+        }
+    }
+    RegisteredAlignment* ra;
+    if (spareAlignments.empty()) {
+        ra = new RegisteredAlignment(alignment);
+    } else {
+        ra = spareAlignments.back();
+        spareAlignments.pop_back();
+        ra->reset(alignment);
+    }
+    group->push_back(ra);
+    last = (count == 0) ? end : max(last, end);
+    lastPushed = end;
+    ++count;
+    return *ra;
+}
+
+void RegisteredAlignments::popLast(void) {
+    RegisteredAlignmentGroup*& group = slots[slot(lastPushed)];
+    release(group->back());
+    group->pop_back();
+    --count;
+    if (group->empty()) {
+        spareGroups.push_back(group);
+        group = NULL;
+    }
+    if (count == 0) {
+        last = base - 1;
+    } else {
+        while (!slots[slot(last)]) {
+            --last;
+        }
+    }
+}
+
+RegisteredAlignmentGroup* RegisteredAlignments::find(long int end) {
+    if (count == 0 || end < base || end > last) {
+        return NULL;
+    }
+    return slots[slot(end)];
+}
+
+void RegisteredAlignments::eraseBefore(long int end) {
+    while (count > 0 && base < end) {
+        RegisteredAlignmentGroup*& group = slots[head];
+        if (group) {
+            count -= group->size();
+            releaseGroup(group);
+            group = NULL;
+        }
+        head = (head + 1) % slots.size();
+        ++base;
+    }
+    if (count == 0) {
+        last = base - 1;
+    }
+}
+
+void RegisteredAlignments::clear(void) {
+    for (long int end = base; end <= last; ++end) {
+        RegisteredAlignmentGroup*& group = slots[slot(end)];
+        if (group) {
+            releaseGroup(group);
+            group = NULL;
+        }
+    }
+    count = 0;
+    last = base - 1;
+}
+
+RegisteredAlignments::~RegisteredAlignments(void) {
+    clear();
+    for (vector<RegisteredAlignment*>::iterator ra = spareAlignments.begin(); ra != spareAlignments.end(); ++ra) {
+        delete *ra;
+    }
+    for (vector<RegisteredAlignmentGroup*>::iterator group = spareGroups.begin(); group != spareGroups.end(); ++group) {
+        delete *group;
+    }
+}
+
+// the alleles are dropped at once, but their vector keeps its storage for the
+// next alignment registered in this object's place
+void RegisteredAlignments::release(RegisteredAlignment* ra) {
+    ra->alleles.clear();
+    spareAlignments.push_back(ra);
+}
+
+void RegisteredAlignments::releaseGroup(RegisteredAlignmentGroup* group) {
+    for (RegisteredAlignmentGroup::iterator ra = group->begin(); ra != group->end(); ++ra) {
+        release(*ra);
+    }
+    group->clear();
+    spareGroups.push_back(group);
+}
+
+// ensures the buffer has a slot for the given end position, moving the
+// groups it holds into a larger buffer if it does not
+void RegisteredAlignments::reserve(long int end) {
+    if (slots.empty()) {
+        slots.resize(REGISTERED_ALIGNMENT_SLOTS, NULL);
+    }
+    if (count == 0) {
+        base = end;
+        head = 0;
+        return;
+    }
+    if (end >= base && end < base + (long int) slots.size()) {
+        return;
+    }
+    long int newBase = min(base, end);
+    long int span = max(last, end) - newBase + 1;
+    size_t size = slots.size();
+    while ((long int) size < span) {
+        size *= 2;
+    }
+    vector<RegisteredAlignmentGroup*> grown(size, (RegisteredAlignmentGroup*) NULL);
+    for (long int e = base; e <= last; ++e) {
+        grown[e - newBase] = slots[slot(e)];
+    }
+    slots.swap(grown);
+    base = newBase;
+    head = 0;
+}
+
 void AlleleParser::buildHaplotypeAlleles(
     vector<Allele>& alleles,
     Samples& samples,
@@ -3131,11 +3392,12 @@ void AlleleParser::buildHaplotypeAlleles(
             registeredAlleles.clear();
             samples.clear();
 
-            long int maxAlignmentEnd = registeredAlignments.rbegin()->first;
+            long int maxAlignmentEnd = registeredAlignments.lastEnd();
             for (long int i = currentPosition+1; i < maxAlignmentEnd; ++i) {
-                deque<RegisteredAlignment>& ras = registeredAlignments[i];
-                for (deque<RegisteredAlignment>::iterator r = ras.begin(); r != ras.end(); ++r) {
-                    RegisteredAlignment& ra = *r;
+                RegisteredAlignmentGroup* ras = registeredAlignments.find(i);
+                if (!ras) continue;
+                for (RegisteredAlignmentGroup::iterator r = ras->begin(); r != ras->end(); ++r) {
+                    RegisteredAlignment& ra = **r;
                     if (ra.start > currentPosition && ra.start < currentPosition + haplotypeLength
                         || ra.end > currentPosition && ra.end < currentPosition + haplotypeLength) {
                         Allele* aptr;
@@ -3235,7 +3497,7 @@ void AlleleParser::buildHaplotypeAlleles(
         */
 
         if (parameters.debug) {
-            cerr << "refr_seq\t" << currentPosition << "\t\t" << reference.getSubSequence(currentSequenceName, currentPosition, haplotypeLength) << endl;
+            cerr << "refr_seq\t" << currentPosition << "\t\t" << referenceSubSequence(currentSequenceName, currentPosition, haplotypeLength) << endl;
             for (vector<Allele*>::iterator h = haplotypeObservations.begin(); h != haplotypeObservations.end(); ++h) {
                 if ((*h)->position == currentPosition && (*h)->referenceLength == haplotypeLength) {
                     cerr << "haplo_obs\t" << (*h)->position << "\t" << (*h)->lnquality << "\t"
@@ -3263,15 +3525,15 @@ void AlleleParser::buildHaplotypeAlleles(
 
         /*
         for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-            cerr << s->first << endl;
-            for (Sample::iterator t = s->second.begin(); t != s->second.end(); ++t) {
+            cerr << (*s)->name << endl;
+            for (Sample::iterator t = (*s)->begin(); t != (*s)->end(); ++t) {
                 cerr << t->first << " " << t->second << endl << endl;
             }
         }
         */
 
         Allele refAllele = genotypeAllele(ALLELE_REFERENCE,
-                                          uppercase(reference.getSubSequence(currentSequenceName, currentPosition, haplotypeLength)),
+                                          uppercase(referenceSubSequence(currentSequenceName, currentPosition, haplotypeLength)),
                                           haplotypeLength,
                                           convert(haplotypeLength)+"M",
                                           haplotypeLength,
@@ -3401,12 +3663,17 @@ void AlleleParser::buildHaplotypeAlleles(
         registeredAlleles.clear();
 
         // reset registered alleles
-        for (map<long unsigned int, deque<RegisteredAlignment> >::iterator ras = registeredAlignments.begin(); ras != registeredAlignments.end(); ++ras) {
-            deque<RegisteredAlignment>& rq = ras->second;
-            for (deque<RegisteredAlignment>::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
-                RegisteredAlignment& ra = *rai;
+        // fitting haplotypes has rebuilt the alleles of the alignments, so
+        // the queue is refilled from them
+        registeredAlleleQueue.clear();
+        for (long int end = registeredAlignments.firstEnd(); end <= registeredAlignments.lastEnd(); ++end) {
+            RegisteredAlignmentGroup* ras = registeredAlignments.find(end);
+            if (!ras) continue;
+            RegisteredAlignmentGroup& rq = *ras;
+            for (RegisteredAlignmentGroup::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
+                RegisteredAlignment& ra = **rai;
                 for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
-                    registeredAlleles.push_back(&*a);
+                    registeredAlleleQueue.add(&*a);
                 }
             }
         }
@@ -3430,18 +3697,17 @@ void AlleleParser::buildHaplotypeAlleles(
 
     // redundant?
 
-    // remove alleles which should no longer be considered
-    removePreviousAlleles(registeredAlleles);
-
     lastHaplotypeLength = haplotypeLength;
 
 }
 
 bool AlleleParser::getCompleteObservationsOfHaplotype(Samples& samples, int haplotypeLength, vector<Allele*>& haplotypeObservations) {
-    for (map<long unsigned int, deque<RegisteredAlignment> >::iterator ras = registeredAlignments.begin(); ras != registeredAlignments.end(); ++ras) {
-        deque<RegisteredAlignment>& rq = ras->second;
-        for (deque<RegisteredAlignment>::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
-            RegisteredAlignment& ra = *rai;
+    for (long int end = registeredAlignments.firstEnd(); end <= registeredAlignments.lastEnd(); ++end) {
+        RegisteredAlignmentGroup* ras = registeredAlignments.find(end);
+        if (!ras) continue;
+        RegisteredAlignmentGroup& rq = *ras;
+        for (RegisteredAlignmentGroup::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
+            RegisteredAlignment& ra = **rai;
             Allele* aptr;
             // this guard prevents trashing allele pointers when getting partial observations
             if (ra.start <= currentPosition && ra.end >= currentPosition + haplotypeLength) {
@@ -3464,10 +3730,12 @@ bool AlleleParser::getCompleteObservationsOfHaplotype(Samples& samples, int hapl
 }
 
 void AlleleParser::unsetAllProcessedFlags(void) {
-    for (map<long unsigned int, deque<RegisteredAlignment> >::iterator ras = registeredAlignments.begin(); ras != registeredAlignments.end(); ++ras) {
-        deque<RegisteredAlignment>& rq = ras->second;
-        for (deque<RegisteredAlignment>::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
-            RegisteredAlignment& ra = *rai;
+    for (long int end = registeredAlignments.firstEnd(); end <= registeredAlignments.lastEnd(); ++end) {
+        RegisteredAlignmentGroup* ras = registeredAlignments.find(end);
+        if (!ras) continue;
+        RegisteredAlignmentGroup& rq = *ras;
+        for (RegisteredAlignmentGroup::iterator rai = rq.begin(); rai != rq.end(); ++rai) {
+            RegisteredAlignment& ra = **rai;
             Allele* aptr;
             for (vector<Allele>::iterator a = ra.alleles.begin(); a != ra.alleles.end(); ++a) {
                 a->processed = false; // re-trigger use of all alleles
@@ -3489,11 +3757,12 @@ bool AlleleParser::getPartialObservationsOfHaplotype(Samples& samples, int haplo
     vector<Allele*> partialObs;
     // now get the partial obs
     // get the max alignment end position, iterate to there
-    long int maxAlignmentEnd = registeredAlignments.rbegin()->first;
+    long int maxAlignmentEnd = registeredAlignments.lastEnd();
     for (long int i = currentPosition+1; i < maxAlignmentEnd; ++i) {
-        deque<RegisteredAlignment>& ras = registeredAlignments[i];
-        for (deque<RegisteredAlignment>::iterator r = ras.begin(); r != ras.end(); ++r) {
-            RegisteredAlignment& ra = *r;
+        RegisteredAlignmentGroup* ras = registeredAlignments.find(i);
+        if (!ras) continue;
+        for (RegisteredAlignmentGroup::iterator r = ras->begin(); r != ras->end(); ++r) {
+            RegisteredAlignment& ra = **r;
             if (ra.start > currentPosition && ra.start < currentPosition + haplotypeLength
                 || ra.end > currentPosition && ra.end < currentPosition + haplotypeLength) {
                 Allele* aptr;
@@ -3525,29 +3794,99 @@ bool AlleleParser::getPartialObservationsOfHaplotype(Samples& samples, int haplo
 bool AlleleParser::getNextAlleles(Samples& samples, int allowedAlleleTypes) {
     long int nextPosition = currentPosition + lastHaplotypeLength;
     while (currentPosition < nextPosition) {
-        if (!toNextPosition()) {
+        if (!toNextPosition()
+            || (skipUninformativePositions && !toNextInformativePosition(allowedAlleleTypes))) {
             return false;
         } else {
             if (justSwitchedTargets) {
                 nextPosition = 0;
                 justSwitchedTargets = false;
             }
-            getAlleles(samples, allowedAlleleTypes);
+            getAlleles(samples, allowedAlleleTypes, 1, false, true, true);
         }
     }
     lastHaplotypeLength = 1;
     return true;
 }
 
+// true if a non-reference allele of an allowed type starts at the current
+// position, or the input VCF has alleles here
+bool AlleleParser::isInformativePosition(int allowedAlleleTypes) {
+    return hasInputVariantAllelesAtCurrentPosition()
+        || registeredAlleleQueue.hasVariantAtPosition(allowedAlleleTypes);
+}
+
+// the next position after the current one at which an informative allele
+// could appear
+//
+// alleles are only registered as the alignments carrying them are reached,
+// so this is bounded by the start of the next unregistered alignment as well
+// as by the registered non-reference alleles and the input VCF
+long int AlleleParser::nextInformativePosition(int allowedAlleleTypes) {
+
+    long int next = registeredAlleleQueue.nextVariantPosition(allowedAlleleTypes);
+
+    if (hasMoreAlignments
+        && currentAlignment.RefID == currentRefID
+        && currentAlignment.Position > currentPosition
+        && (next == -1 || currentAlignment.Position < next)) {
+        next = currentAlignment.Position;
+    }
+
+    if (usingVariantInputAlleles) {
+        // variants are loaded in windows, so don't pass the end of the last
+        map<long int, vector<Allele> >::iterator v = inputVariantAlleles.upper_bound(currentPosition);
+        if (v != inputVariantAlleles.end() && (next == -1 || v->first < next)) {
+            next = v->first;
+        }
+        if (rightmostInputAllelePosition > currentPosition
+            && (next == -1 || rightmostInputAllelePosition < next)) {
+            next = rightmostInputAllelePosition;
+        }
+    }
+
+    if (!targets.empty()) {
+        // stepping past the right edge moves us to the next target
+        if (next == -1 || currentTarget->right < next) {
+            next = currentTarget->right;
+        }
+    } else if (next == -1) {
+        // step through the ends of the registered alignments, which lets
+        // toNextPosition switch sequences once they have all been passed
+        if (!registeredAlignments.empty()) {
+            next = registeredAlignments.lastEnd() + lastHaplotypeLength + 1;
+        } else {
+            next = currentPosition + 1;
+        }
+    }
+
+    return max(next, currentPosition + 1);
+
+}
+
+// steps forward until an informative position is reached, jumping over the
+// positions between those at which informative alleles could appear
+bool AlleleParser::toNextInformativePosition(int allowedAlleleTypes) {
+    while (!isInformativePosition(allowedAlleleTypes)) {
+        currentPosition = nextInformativePosition(allowedAlleleTypes) - 1;
+        if (!toNextPosition()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void AlleleParser::getAlleles(Samples& samples, int allowedAlleleTypes,
                               int haplotypeLength, bool getAllAllelesInHaplotype,
-                              bool ignoreProcessedFlag) {
+                              bool ignoreProcessedFlag, bool fromQueue) {
 
     DEBUG2("getting alleles");
 
-    for (Samples::iterator s = samples.begin(); s != samples.end(); ++s)
-        s->second.clear();
-    // TODO ^^^ this should be optimized for better scanning performance
+    // observations are grouped into samples by their index in sampleNames
+    if (samples.sampleCount() != (int) sampleNames.size()) {
+        samples.setNames(sampleNames);
+    }
+    samples.beginSite();
 
     // if we have targets and are outside of the current target, don't return anything
 
@@ -3555,52 +3894,70 @@ void AlleleParser::getAlleles(Samples& samples, int allowedAlleleTypes,
     if (parameters.useRefAllele) {
         if (currentReferenceAllele) delete currentReferenceAllele; // clean up after last position
         currentReferenceAllele = referenceAllele(parameters.MQR, parameters.BQR);
-        samples[referenceSampleName].clear();
-        samples[referenceSampleName][currentReferenceAllele->currentBase].push_back(currentReferenceAllele);
+        samples.observe(referenceSampleIndex)[currentReferenceAllele->currentBase].push_back(currentReferenceAllele);
         //alleles.push_back(currentReferenceAllele);
     }
 
     // get the variant alleles *at* the current position
     // and the reference alleles *overlapping* the current position
-    for (vector<Allele*>::const_iterator a = registeredAlleles.begin(); a != registeredAlleles.end(); ++a) {
-        Allele& allele = **a;
-        //cerr << "getting alleles at position " << currentPosition << " with length " << haplotypeLength << " " << allele << endl;
-        if (!ignoreProcessedFlag && allele.processed) continue;
-        if (allowedAlleleTypes & allele.type
-            && ((haplotypeLength > 1 &&
-                 ((allele.type == ALLELE_REFERENCE
-                   && allele.position <= currentPosition 
-                   && allele.position + allele.referenceLength >= currentPosition + haplotypeLength)
-                  || 
-                  (allele.position == currentPosition
-                   && allele.referenceLength == haplotypeLength)
-                  ||
-                  (getAllAllelesInHaplotype
-                   && allele.type != ALLELE_REFERENCE
-                   && allele.position >= currentPosition
-                   && allele.position < currentPosition + haplotypeLength)))
-                ||
-                (haplotypeLength == 1 &&
-                 ((allele.type == ALLELE_REFERENCE
-                   && allele.position <= currentPosition
-                   && allele.position + allele.referenceLength > currentPosition)
-                  || 
-                  (allele.position == currentPosition)))
-                ) ) {
-            allele.update(haplotypeLength);
-            if (allele.quality >= parameters.BQL0 && allele.currentBase != "N"
-                && (allele.isReference() || !allele.alternateSequence.empty())) { // filters haplotype construction chaff
-                //cerr << "keeping allele " << allele << endl;
-                samples[allele.sampleID][allele.currentBase].push_back(*a);
-                // XXX testing
-                if (!getAllAllelesInHaplotype) {
-                    allele.processed = true;
-                    if (haplotypeLength > 1) {
-                        if (!allele.isReference() && !(allele.position == currentPosition && allele.referenceLength == haplotypeLength)) {
-                            cerr << "non-reference allele should not be added to result alleles because it does not match the haplotype!:" << endl;
-                            cerr << "haplotype is from " << currentPosition << " to " << currentPosition + haplotypeLength << ", " << haplotypeLength << "bp" << endl;
-                            cerr << allele << endl;
-                            assert(false);
+    // when stepping through single positions, the queue holds just these
+    vector<vector<Allele*>*> candidates;
+    if (fromQueue) {
+        candidates.push_back(&registeredAlleleQueue.spanning);
+        candidates.push_back(&registeredAlleleQueue.starting);
+    } else {
+        candidates.push_back(&registeredAlleles);
+    }
+    for (vector<vector<Allele*>*>::iterator c = candidates.begin(); c != candidates.end(); ++c) {
+        for (vector<Allele*>::const_iterator a = (*c)->begin(); a != (*c)->end(); ++a) {
+            Allele& allele = **a;
+            //cerr << "getting alleles at position " << currentPosition << " with length " << haplotypeLength << " " << allele << endl;
+            if (!ignoreProcessedFlag && allele.processed) continue;
+            if (allowedAlleleTypes & allele.type
+                && ((haplotypeLength > 1 &&
+                     ((allele.type == ALLELE_REFERENCE
+                       && allele.position <= currentPosition 
+                       && allele.position + allele.referenceLength >= currentPosition + haplotypeLength)
+                      || 
+                      (allele.position == currentPosition
+                       && allele.referenceLength == haplotypeLength)
+                      ||
+                      (getAllAllelesInHaplotype
+                       && allele.type != ALLELE_REFERENCE
+                       && allele.position >= currentPosition
+                       && allele.position < currentPosition + haplotypeLength)))
+                    ||
+                    (haplotypeLength == 1 &&
+                     ((allele.type == ALLELE_REFERENCE
+                       && allele.position <= currentPosition
+                       && allele.position + allele.referenceLength > currentPosition)
+                      || 
+                      (allele.position == currentPosition)))
+                    ) ) {
+                // reference observations stepped over from the queue are
+                // only counted here, see Samples::addReferenceObservations
+                if (fromQueue && haplotypeLength == 1 && allele.type == ALLELE_REFERENCE) {
+                    if (allele.referenceBaseQuality() >= parameters.BQL0 && currentReferenceBase != 'N') {
+                        samples.observe(allele.sampleIndex).referenceObservations.push_back(*a);
+                        allele.processed = true;
+                    }
+                    continue;
+                }
+                allele.update(haplotypeLength);
+                if (allele.quality >= parameters.BQL0 && allele.currentBase != "N"
+                    && (allele.isReference() || !allele.alternateSequence.empty())) { // filters haplotype construction chaff
+                    //cerr << "keeping allele " << allele << endl;
+                    samples.observe(allele.sampleIndex)[allele.currentBase].push_back(*a);
+                    // XXX testing
+                    if (!getAllAllelesInHaplotype) {
+                        allele.processed = true;
+                        if (haplotypeLength > 1) {
+                            if (!allele.isReference() && !(allele.position == currentPosition && allele.referenceLength == haplotypeLength)) {
+                                cerr << "non-reference allele should not be added to result alleles because it does not match the haplotype!:" << endl;
+                                cerr << "haplotype is from " << currentPosition << " to " << currentPosition + haplotypeLength << ", " << haplotypeLength << "bp" << endl;
+                                cerr << allele << endl;
+                                assert(false);
+                            }
                         }
                     }
                 }
@@ -3608,44 +3965,16 @@ void AlleleParser::getAlleles(Samples& samples, int allowedAlleleTypes,
         }
     }
 
-    vector<string> samplesToErase;
-    // now remove empty alleles from our return so as to not confuse processing
-    for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-
-        const string& name = s->first;
-        Sample& sample = s->second;
-
-        // move updated reference alleles to the right bin
-        // everything else will get axed
-        //sample.sortReferenceAlleles();
-
-        bool empty = true;
-        vector<string> genotypesToErase;
-        // and remove any empty groups which remain
-        for (Sample::iterator g = sample.begin(); g != sample.end(); ++g) {
-            if (g->second.empty()) {
-                //cerr << "sample " << name << " has an empty " << g->first << endl;
-                //sample.erase(g);
-                genotypesToErase.push_back(g->first);
-            } else {
-                // accumulate bitmap of unique types
-                empty = false;
-            }
-        }
-
-        for (vector<string>::iterator gt = genotypesToErase.begin(); gt != genotypesToErase.end(); ++gt) {
-            sample.erase(*gt);
-        }
-
-        // and remove the entire sample if it has no alleles
-        if (empty || currentSamplePloidy(name) == 0) {
-            samplesToErase.push_back(name);
+    // only samples with observations are observed, so only those of no
+    // copies at this position are removed
+    for (Samples::iterator s = samples.begin(); s != samples.end(); ) {
+        if (currentSamplePloidy((*s)->name) == 0) {
+            s = samples.erase(s);
+        } else {
+            ++s;
         }
     }
-
-    for (vector<string>::iterator name = samplesToErase.begin(); name != samplesToErase.end(); ++name) {
-        samples.erase(*name);
-    }
+    samples.endSite();
 
     DEBUG2("done getting alleles");
 
@@ -3654,12 +3983,12 @@ void AlleleParser::getAlleles(Samples& samples, int allowedAlleleTypes,
 Allele* AlleleParser::referenceAllele(int mapQ, int baseQ) {
     string base = currentReferenceBaseString();
     //string name = reference.filename;
-    string name = currentSequenceName; // this behavior matches old bambayes
-    string sequencingTech = "reference";
+    const string* name = currentSequenceID; // this behavior matches old bambayes
+    const string* sequencingTech = internName("reference");
     string baseQstr = "";
     //baseQstr += qualityInt2Char(baseQ);
     Allele* allele = new Allele(ALLELE_REFERENCE, 
-                                currentSequenceName,
+                                currentSequenceID,
                                 currentPosition,
                                 &currentPosition, 
                                 &currentReferenceBase,
@@ -3734,7 +4063,7 @@ vector<Allele> AlleleParser::genotypeAlleles(
                 if (haplotypeLength == 1) {
                     altseq = currentReferenceBase;
                 } else {
-                    altseq = uppercase(reference.getSubSequence(currentSequenceName, currentPosition, haplotypeLength));
+                    altseq = uppercase(referenceSubSequence(currentSequenceName, currentPosition, haplotypeLength));
                 }
             }
             unfilteredAlleles.push_back(make_pair(genotypeAllele(allele.type,
@@ -3760,7 +4089,7 @@ vector<Allele> AlleleParser::genotypeAlleles(
         DEBUG("genotype allele: " << genotypeAllele << " qsum " << qSum);
 
         for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-            Sample& sample = s->second; 
+            Sample& sample = **s;
             int alleleCount = 0;
             int qsum = 0;
             Sample::iterator c = sample.find(genotypeAllele.currentBase);
@@ -3777,7 +4106,7 @@ vector<Allele> AlleleParser::genotypeAlleles(
                 && alleleCount >= parameters.minAltCount 
                 && ((float) alleleCount / (float) observationCount) >= parameters.minAltFraction) {
                 DEBUG(genotypeAllele << " has support of " << alleleCount 
-                      << " in individual " << s->first << " (" << observationCount << " obs)" <<  " and fraction " 
+                      << " in individual " << (*s)->name << " (" << observationCount << " obs)" <<  " and fraction " 
                       << (float) alleleCount / (float) observationCount);
                 filteredAlleles[genotypeAllele] = qSum;
                 break;
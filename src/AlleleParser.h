@@ -22,8 +22,13 @@
 #include "Allele.h"
 #include "Sample.h"
 #include "Fasta.h"
+#include "PackedReference.h"
+#include "BgzfOutput.h"
 #include "TryCatch.h"
 #include "api/BamMultiReader.h"
+#include "AlignmentPrefetcher.h"
+#include "Checkpoint.h"
+#include "AlleleQueue.h"
 #include "Genotype.h"
 #include "CNV.h"
 #include "Result.h"
@@ -44,6 +49,23 @@ using namespace BamTools;
 // a structure holding information about our parameters
 
 // structure to encapsulate registered reads and alleles
+// a read group of the input, resolved against the headers once so that
+// alignments need only find its index
+class ReadGroup {
+public:
+    const string* id;          // all interned
+    const string* sample;
+    const string* technology;  // empty if the header gives none
+    int sampleIndex;           // of its sample in the parser's sampleNames
+
+    ReadGroup(const string* i, const string* s, const string* t, int si)
+        : id(i)
+        , sample(s)
+        , technology(t)
+        , sampleIndex(si)
+    { }
+};
+
 class RegisteredAlignment {
     friend ostream &operator<<(ostream &out, RegisteredAlignment &a);
 public:
@@ -52,7 +74,9 @@ public:
     long unsigned int end;
     int refid;
     string name;
-    string readgroup;
+    const string* readGroupID; // interned, for the alleles of the alignment
+    int readGroupIndex; // in the parser's table of read groups
+    int sampleIndex; // of the sample of the read group in the parser's sampleNames
     vector<Allele> alleles;
     int mismatches;
     int snpCount;
@@ -65,12 +89,36 @@ public:
         , end(alignment.GetEndPosition())
         , refid(alignment.RefID)
         , name(alignment.Name)
+        , readGroupID(NULL)
+        , readGroupIndex(-1)
+        , sampleIndex(-1)
         , mismatches(0)
         , snpCount(0)
         , indelCount(0)
         , alleleTypes(0)
-    {
-        alignment.GetTag("RG", readgroup);
+    { }
+
+    // the read group of the alignment, as resolved by the parser
+    void setReadGroup(int index, const ReadGroup& readGroup) {
+        readGroupID = readGroup.id;
+        readGroupIndex = index;
+        sampleIndex = readGroup.sampleIndex;
+    }
+
+    // reinitializes a recycled alignment, keeping the storage of its alleles
+    void reset(BamAlignment& alignment) {
+        start = alignment.Position;
+        end = alignment.GetEndPosition();
+        refid = alignment.RefID;
+        name = alignment.Name;
+        readGroupID = NULL;
+        readGroupIndex = -1;
+        sampleIndex = -1;
+        alleles.clear();
+        mismatches = 0;
+        snpCount = 0;
+        indelCount = 0;
+        alleleTypes = 0;
     }
 
     void addAllele(Allele allele, bool mergeComplex = true,
@@ -79,6 +127,78 @@ public:
 
 };
 
+// the initial number of end positions held by RegisteredAlignments
+#define REGISTERED_ALIGNMENT_SLOTS 1024
+
+// the alignments ending at one position
+typedef vector<RegisteredAlignment*> RegisteredAlignmentGroup;
+
+// the registered alignments, grouped by end position
+//
+// the groups are held in a circular buffer with one slot per position from
+// the earliest end still held, which grows to span the ends of the alignments
+// overlapping the window; expired slots are released from the front as the
+// window moves on
+//
+// alignments are never moved, so pointers to their alleles stay valid until
+// they expire; expired alignments and groups are kept for reuse rather than
+// freed, so that in a steady window registering an alignment allocates little
+// beyond its alleles' own sequences
+class RegisteredAlignments {
+
+public:
+
+    RegisteredAlignments(void)
+        : base(0)
+        , head(0)
+        , last(-1)
+        , lastPushed(0)
+        , count(0)
+    { }
+
+    ~RegisteredAlignments(void);
+
+    // registers the alignment under its end position
+    RegisteredAlignment& push(BamAlignment& alignment);
+
+    // removes the most recently pushed alignment
+    void popLast(void);
+
+    // the alignments ending at the given position, or NULL if there are none
+    RegisteredAlignmentGroup* find(long int end);
+
+    bool empty(void) { return count == 0; }
+    long int firstEnd(void) { return base; } // bounds on the ends of the alignments
+    long int lastEnd(void) { return last; }
+
+    // removes the alignments ending before the given position
+    void eraseBefore(long int end);
+
+    void clear(void);
+
+private:
+
+    vector<RegisteredAlignmentGroup*> slots;
+    long int base;       // the end position held in slots[head]
+    size_t head;
+    long int last;       // the greatest end position held
+    long int lastPushed;
+    int count;           // the number of alignments held
+
+    vector<RegisteredAlignment*> spareAlignments; // expired, for reuse
+    vector<RegisteredAlignmentGroup*> spareGroups;
+
+    size_t slot(long int end) { return (head + (end - base)) % slots.size(); }
+    void reserve(long int end);
+    void release(RegisteredAlignment* ra);
+    void releaseGroup(RegisteredAlignmentGroup* group);
+
+    // the alignments and groups are owned by the buffer
+    RegisteredAlignments(const RegisteredAlignments&);
+    RegisteredAlignments& operator=(const RegisteredAlignments&);
+
+};
+
 // functor to filter alleles outside of our analysis window
 class AlleleFilter {
 
@@ -129,14 +249,18 @@ public:
     Parameters parameters; // holds operational parameters passed at program invocation
     
     AlleleParser(int argc, char** argv);
+    AlleleParser(const Parameters& params);
     ~AlleleParser(void); 
 
     vector<string> sampleList; // list of sample names, indexed by sample id
+    vector<string> sampleNames; // the samples which may be observed: sampleList, then any other samples of the read groups and the reference sample
     vector<string> sampleListFromBam; // sample names drawn from BAM file
     vector<string> sampleListFromVCF; // sample names drawn from input VCF
     map<string, string> samplePopulation; // population subdivisions of samples
     map<string, vector<string> > populationSamples; // inversion of samplePopulation
     map<string, string> readGroupToSampleNames; // maps read groups to samples
+    vector<ReadGroup> readGroups; // the read groups of the headers, by index
+    map<string, int> readGroupIndexes; // maps read group ids to their index in the above
     map<string, string> readGroupToTechnology; // maps read groups to technologies
     vector<string> sequencingTechnologies;  // a list of the present technologies
 
@@ -144,9 +268,12 @@ public:
 
     // reference
     FastaReference reference;
+    PackedReference* packedReference; // shared with the other parsers, if --reference-in-memory is set
+    string referenceExtension; // reused to extend the cached reference for each alignment
     vector<string> referenceSequenceNames;
     map<int, string> referenceIDToName;
     string referenceSampleName;
+    int referenceSampleIndex; // in sampleNames
     
     // target regions
     vector<BedTarget> targets;
@@ -156,6 +283,9 @@ public:
 
     // bamreader
     BamMultiReader bamMultiReader;
+    // reads ahead from bamMultiReader in a separate thread
+    // once the BAMs are open, alignments are only read through this
+    AlignmentPrefetcher alignmentPrefetcher;
 
     // bed reader
     BedReader bedReader;
@@ -184,19 +314,20 @@ public:
 		      int basesLeft,
 		      int basesRight,
 		      string& readSequence,
-		      string& sampleName,
+		      const string* sampleName,
 		      BamAlignment& alignment,
-		      string& sequencingTech,
-		      long double qual,
+		      const string* sequencingTech,
+		      ProbFloat qual,
 		      string& qualstr);
 
 
 
-    vector<Allele*> registeredAlleles;
-    map<long unsigned int, deque<RegisteredAlignment> > registeredAlignments;
+    AlleleQueue registeredAlleleQueue; // the registered alleles, by position
+    vector<Allele*> registeredAlleles; // working set used in haplotype construction
+    RegisteredAlignments registeredAlignments;
     map<long int, vector<Allele> > inputVariantAlleles; // all variants present in the input VCF, as 'genotype' alleles
     //  position         sample     genotype  likelihood
-    map<long int, map<string, map<string, long double> > > inputGenotypeLikelihoods; // drawn from input VCF
+    map<long int, map<string, map<string, ProbFloat> > > inputGenotypeLikelihoods; // drawn from input VCF
     map<long int, map<Allele, int> > inputAlleleCounts; // drawn from input VCF
     Sample* nullSample;
 
@@ -215,6 +346,7 @@ public:
     string bamHeader;
     vector<string> bamHeaderLines;
  
+    void initialize(void);
     void openBams(void);
     void openTraceFile(void);
     void openFailedFile(void);
@@ -224,10 +356,14 @@ public:
     void getSequencingTechnologies(void);
     void loadSampleCNVMap(void);
     int currentSamplePloidy(string const& sample);
+    void indexReadGroups(void);
+    int readGroupIndex(const string& readGroup);
     int copiesOfLocus(Samples& samples);
     vector<int> currentPloidies(Samples& samples);
     void loadBamReferenceSequenceNames(void);
     void loadFastaReference(void);
+    void referenceSubSequence(const string& seqname, long int start, long int length, string& sequence);
+    string referenceSubSequence(const string& seqname, long int start, long int length);
     void loadReferenceSequence(BedTarget*, int, int);
     void loadReferenceSequence(BamAlignment& alignment);
     void preserveReferenceSequenceWindow(int bp);
@@ -240,7 +376,7 @@ public:
     bool getFirstVariant(void);
     void loadTargetsFromBams(void);
     void initializeOutputFiles(void);
-    RegisteredAlignment& registerAlignment(BamAlignment& alignment, RegisteredAlignment& ra, string& sampleName, string& sequencingTech);
+    RegisteredAlignment& registerAlignment(BamAlignment& alignment, RegisteredAlignment& ra, const string* sampleName, const string* sequencingTech);
     void clearRegisteredAlignments(void);
     void updateAlignmentQueue(long int position, vector<Allele*>& newAlleles, bool gettingPartials = false);
     void updateInputVariants(long int pos, int referenceLength);
@@ -259,6 +395,7 @@ public:
     vector<BedTarget>* targetsInCurrentRefSeq(void);
     bool toNextRefID(void);
     bool loadTarget(BedTarget*);
+    void setTarget(const BedTarget& target);
     bool toFirstTargetPosition(void);
     bool toNextPosition(void);
     bool getCompleteObservationsOfHaplotype(Samples& samples, int haplotypeLength, vector<Allele*>& haplotypeObservations);
@@ -270,6 +407,9 @@ public:
     int currentSequencePosition();
     void unsetAllProcessedFlags(void);
     bool getNextAlleles(Samples& allelesBySample, int allowedAlleleTypes);
+    bool isInformativePosition(int allowedAlleleTypes);
+    long int nextInformativePosition(int allowedAlleleTypes);
+    bool toNextInformativePosition(int allowedAlleleTypes);
 
     // builds up haplotype (longer, e.g. ref+snp+ref) alleles to match the longest allele in genotypeAlleles
     // updates vector<Allele>& alleles with the new alleles
@@ -280,11 +420,14 @@ public:
                                map<string, vector<Allele*> >& partialObservationGroups,
                                map<Allele*, set<Allele*> >& partialObservationSupport,
                                int allowedAlleleTypes);
+    // from the queue, single-base reference observations are only counted,
+    // and must be added with Samples::addReferenceObservations before use
     void getAlleles(Samples& allelesBySample,
                     int allowedAlleleTypes,
                     int haplotypeLength = 1,
                     bool getAllAllelesInHaplotype = false,
-                    bool ignoreProcessedAlleles = true);
+                    bool ignoreProcessedAlleles = true,
+                    bool fromQueue = false);
     Allele* referenceAllele(int mapQ, int baseQ);
     Allele* alternateAllele(int mapQ, int baseQ);
     int homopolymerRunLeft(string altbase);
@@ -310,6 +453,8 @@ public:
     BedTarget* currentTarget;
     long int currentPosition;  // 0-based current position
     int lastHaplotypeLength;
+    bool skipUninformativePositions; // if set, getNextAlleles only stops where
+                                     // non-reference or input alleles start
     char currentReferenceBase;
     string currentSequence;
     char currentReferenceBaseChar();
@@ -320,11 +465,17 @@ public:
     // output files
     ofstream logFile, outputFile, traceFile, failedFile;
     ostream* output;
+    BgzfOutput bgzfOutput;       // --bgzip-output
+    ostream* bgzfStream;
+
+    // the progress of an earlier run, if it is being resumed
+    Checkpoint checkpoint;
 
     // utility
     bool isCpG(string& altbase);
 
     string currentSequenceName;
+    const string* currentSequenceID; // interned, for the alleles of the sequence
 
 private:
 
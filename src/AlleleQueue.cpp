@@ -0,0 +1,133 @@
+#include "AlleleQueue.h"
+
+void AlleleQueue::add(Allele* allele) {
+    long int end = allele->position + allele->referenceLength;
+    if (allele->position > position) {
+        size_t bucket = allele->position - position - 1;
+        if (buckets.size() <= bucket) {
+            buckets.resize(bucket + 1);
+        }
+        buckets[bucket].push_back(allele);
+    } else if (end <= position) {
+        allele->processed = true;
+    } else if (allele->position == position) {
+        starting.push_back(allele);
+    } else if (allele->type == ALLELE_REFERENCE) {
+        addSpanning(allele);
+    } else {
+        allele->processed = true;
+    }
+}
+
+void AlleleQueue::add(vector<Allele*>& alleles) {
+    for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
+        add(*a);
+    }
+}
+
+void AlleleQueue::advance(long int newPosition) {
+
+    if (newPosition == position) {
+        return;
+    }
+
+    if (newPosition < position) {
+        vector<Allele*> alleles;
+        alleles.insert(alleles.end(), spanning.begin(), spanning.end());
+        alleles.insert(alleles.end(), starting.begin(), starting.end());
+        for (deque<vector<Allele*> >::iterator b = buckets.begin(); b != buckets.end(); ++b) {
+            alleles.insert(alleles.end(), b->begin(), b->end());
+        }
+        clear();
+        position = newPosition;
+        add(alleles);
+        return;
+    }
+
+    long int oldPosition = position;
+    position = newPosition;
+
+    // the alleles starting at the old position, and those in the buckets
+    // which are passed over, now start before the current position
+    add(starting);
+    starting.clear();
+    for (long int next = oldPosition + 1; next <= position && !buckets.empty(); ++next) {
+        add(buckets.front());
+        buckets.pop_front();
+    }
+
+    expireSpanning();
+
+}
+
+void AlleleQueue::clear(void) {
+    starting.clear();
+    spanning.clear();
+    buckets.clear();
+}
+
+long int AlleleQueue::lowestPosition(void) {
+    if (!spanning.empty()) {
+        return spanningStart;
+    }
+    if (!starting.empty()) {
+        return position;
+    }
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        if (!buckets[b].empty()) {
+            return position + 1 + b;
+        }
+    }
+    return -1;
+}
+
+long int AlleleQueue::nextVariantPosition(int allowedAlleleTypes) {
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        vector<Allele*>& bucket = buckets[b];
+        for (vector<Allele*>::iterator a = bucket.begin(); a != bucket.end(); ++a) {
+            if ((*a)->type != ALLELE_REFERENCE && (allowedAlleleTypes & (*a)->type)) {
+                return position + 1 + b;
+            }
+        }
+    }
+    return -1;
+}
+
+bool AlleleQueue::hasVariantAtPosition(int allowedAlleleTypes) {
+    for (vector<Allele*>::iterator a = starting.begin(); a != starting.end(); ++a) {
+        if ((*a)->type != ALLELE_REFERENCE && (allowedAlleleTypes & (*a)->type)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AlleleQueue::addSpanning(Allele* allele) {
+    long int end = allele->position + allele->referenceLength;
+    if (spanning.empty()) {
+        spanningStart = allele->position;
+        spanningEnd = end;
+    } else {
+        spanningStart = min(spanningStart, allele->position);
+        spanningEnd = min(spanningEnd, end);
+    }
+    spanning.push_back(allele);
+}
+
+// removes the spanning alleles which end at or before the current position
+// this is only done when one of them does, which in deep data with reads of
+// similar length is far less often than every position
+void AlleleQueue::expireSpanning(void) {
+    if (spanning.empty() || spanningEnd > position) {
+        return;
+    }
+    vector<Allele*> overlapping;
+    overlapping.swap(spanning);
+    for (vector<Allele*>::iterator a = overlapping.begin(); a != overlapping.end(); ++a) {
+        if ((*a)->position + (*a)->referenceLength <= position) {
+            (*a)->processed = true;
+        } else {
+            addSpanning(*a);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef ALLELEQUEUE_H
+#define ALLELEQUEUE_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include "Allele.h"
+
+using namespace std;
+
+// holds the registered alleles as the parser steps along a sequence, so that
+// each position touches only the alleles which overlap it
+//
+// alleles which start after the current position wait in a calendar of
+// buckets, one per position; on reaching a position its bucket becomes the
+// starting alleles, and the reference alleles among them join the spanning
+// set until the position passes their end
+//
+// at a single position, the alleles of interest are those starting there and
+// the reference alleles overlapping it; non-reference alleles which started
+// earlier are not, so they leave the queue once their position has passed
+class AlleleQueue {
+
+public:
+
+    long int position;         // the current position
+    vector<Allele*> starting;  // alleles starting at the current position
+    vector<Allele*> spanning;  // reference alleles starting before the current position which overlap it
+
+    AlleleQueue(void)
+        : position(0)
+        , spanningStart(0)
+        , spanningEnd(0)
+    { }
+
+    // queues alleles by their start, dropping those which end before the
+    // current position
+    void add(Allele* allele);
+    void add(vector<Allele*>& alleles);
+
+    // steps the queue to the given position
+    // stepping backwards requeues every allele against the new position
+    void advance(long int position);
+
+    void clear(void);
+
+    // the leftmost start of the queued alleles, or -1 if there are none
+    long int lowestPosition(void);
+
+    // the first position after the current one at which a non-reference
+    // allele of the allowed types starts, or -1 if none is queued
+    long int nextVariantPosition(int allowedAlleleTypes);
+
+    // true if a non-reference allele of the allowed types starts at the
+    // current position
+    bool hasVariantAtPosition(int allowedAlleleTypes);
+
+private:
+
+    deque<vector<Allele*> > buckets; // buckets[i] holds the alleles starting at position + 1 + i
+    long int spanningStart;          // the leftmost start and earliest end of the spanning alleles
+    long int spanningEnd;
+
+    void addSpanning(Allele* allele);
+    void expireSpanning(void);
+
+};
+
+#endif
@@ -361,6 +361,13 @@ bool BgzfData::Seek(int64_t position) {
     return true;
 }
 
+// reads the block at the given file offset
+int BgzfData::ReadBlockAt(int64_t blockAddress) {
+    if ( !Seek(blockAddress << 16) || !ReadBlock() )
+        return -1;
+    return BlockLength;
+}
+
 // get file position in BGZF file
 int64_t BgzfData::Tell(void) {
     if ( !IsOpen ) 
@@ -103,6 +103,9 @@ struct BgzfData {
         bool Seek(int64_t position);
         // get file position in BGZF file
         int64_t Tell(void);
+        // reads the block starting at the given file offset into UncompressedBlock,
+        // returning the length of its data, or -1 on failure
+        int ReadBlockAt(int64_t blockAddress);
         // writes the supplied data into the BGZF buffer
         unsigned int Write(const char* data, const unsigned int dataLen);
 
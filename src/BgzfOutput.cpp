@@ -0,0 +1,309 @@
+#include "BgzfOutput.h"
+#include "BGZF.h"
+#include "split.h"
+#include <string.h>
+#include <stdlib.h>
+
+using namespace BamTools;
+
+// marks windows of the linear index which no record has reached yet
+static const uint64_t UNSET_OFFSET = (uint64_t) -1;
+
+// the smallest bin of the UCSC binning scheme which holds [begin, end)
+static unsigned int regionToBin(long int begin, long int end) {
+    --end;
+    if (begin >> 14 == end >> 14) return ((1 << 15) - 1) / 7 + (begin >> 14);
+    if (begin >> 17 == end >> 17) return ((1 << 12) - 1) / 7 + (begin >> 17);
+    if (begin >> 20 == end >> 20) return ((1 << 9) - 1) / 7 + (begin >> 20);
+    if (begin >> 23 == end >> 23) return ((1 << 6) - 1) / 7 + (begin >> 23);
+    if (begin >> 26 == end >> 26) return ((1 << 3) - 1) / 7 + (begin >> 26);
+    return 0;
+}
+
+void bgzfCompressBlock(const string& data, string& block) {
+
+    block.resize(MAX_BLOCK_SIZE);
+    char* buffer = &block[0];
+
+    z_stream zs;
+    zs.zalloc = NULL;
+    zs.zfree = NULL;
+    zs.opaque = NULL;
+    zs.next_in = (Bytef*) data.data();
+    zs.avail_in = data.size();
+    zs.next_out = (Bytef*) buffer + BLOCK_HEADER_LENGTH;
+    zs.avail_out = MAX_BLOCK_SIZE - BLOCK_HEADER_LENGTH - BLOCK_FOOTER_LENGTH;
+
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, Z_DEFAULT_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK
+        || deflate(&zs, Z_FINISH) != Z_STREAM_END
+        || deflateEnd(&zs) != Z_OK) {
+        cerr << "ERROR(freebayes): could not compress output block" << endl;
+        exit(1);
+    }
+
+    int length = BLOCK_HEADER_LENGTH + zs.total_out + BLOCK_FOOTER_LENGTH;
+
+    // the gzip header, with the BGZF extra field giving the block size
+    buffer[0] = GZIP_ID1;
+    buffer[1] = (char) GZIP_ID2;
+    buffer[2] = CM_DEFLATE;
+    buffer[3] = FLG_FEXTRA;
+    BgzfData::PackUnsignedInt(&buffer[4], 0); // modification time
+    buffer[8] = 0;
+    buffer[9] = (char) OS_UNKNOWN;
+    BgzfData::PackUnsignedShort(&buffer[10], BGZF_XLEN);
+    buffer[12] = BGZF_ID1;
+    buffer[13] = BGZF_ID2;
+    BgzfData::PackUnsignedShort(&buffer[14], BGZF_LEN);
+    BgzfData::PackUnsignedShort(&buffer[16], length - 1);
+
+    // and the footer, with the checksum and length of the data
+    uLong crc = crc32(crc32(0L, NULL, 0L), (Bytef*) data.data(), data.size());
+    BgzfData::PackUnsignedInt(&buffer[length - 8], crc);
+    BgzfData::PackUnsignedInt(&buffer[length - 4], data.size());
+
+    block.resize(length);
+
+}
+
+void TabixSequenceIndex::add(long int begin, long int end, uint64_t start, uint64_t stop) {
+    if (end <= begin) {
+        end = begin + 1;
+    }
+    vector<pair<uint64_t, uint64_t> >& chunks = bins[regionToBin(begin, end)];
+    if (!chunks.empty() && chunks.back().second == start) {
+        chunks.back().second = stop;
+    } else {
+        chunks.push_back(make_pair(start, stop));
+    }
+    long int last = (end - 1) >> 14;
+    if ((long int) linear.size() <= last) {
+        linear.resize(last + 1, UNSET_OFFSET);
+    }
+    for (long int w = begin >> 14; w <= last; ++w) {
+        if (linear[w] == UNSET_OFFSET) {
+            linear[w] = start;
+        }
+    }
+}
+
+BgzfOutput::BgzfOutput(void)
+    : file(NULL)
+    , pool(NULL)
+    , blockNumber(0)
+    , address(0)
+    , recordTabs(0)
+    , recordStart(0)
+    , atLineStart(true)
+{ }
+
+BgzfOutput::~BgzfOutput(void) {
+    close();
+}
+
+bool BgzfOutput::open(const string& name, int threads) {
+    filename = name;
+    file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    pool = new TaskPool(threads);
+    setp(block, block + BGZF_OUTPUT_BLOCK_SIZE);
+    return true;
+}
+
+int BgzfOutput::overflow(int c) {
+    endBlock();
+    if (c != traits_type::eof()) {
+        *pptr() = c;
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+// queues the filled block for compression
+void BgzfOutput::endBlock(void) {
+    int length = pptr() - pbase();
+    if (length == 0) {
+        return;
+    }
+    scanBlock(length);
+    pending.push_back(string(block, length));
+    ++blockNumber;
+    setp(block, block + BGZF_OUTPUT_BLOCK_SIZE);
+    if ((int) pending.size() >= pool->size() * BGZF_OUTPUT_BLOCKS_PER_THREAD) {
+        writePending();
+    }
+}
+
+// finds the records in the block, keeping the fields needed to index them
+void BgzfOutput::scanBlock(int length) {
+    int i = 0;
+    while (i < length) {
+        if (atLineStart) {
+            recordStart = ((uint64_t) blockNumber << 16) | i;
+            recordFields.clear();
+            recordTabs = 0;
+            atLineStart = false;
+        }
+        // past the reference allele, skip to the end of the line
+        if (recordTabs >= 4) {
+            const char* newline = (const char*) memchr(block + i, '\n', length - i);
+            if (!newline) {
+                return;
+            }
+            i = newline - block;
+        }
+        char c = block[i++];
+        if (c == '\n') {
+            // a record ending its block ends at the start of the next
+            if (i == length) {
+                endRecord((uint64_t) (blockNumber + 1) << 16);
+            } else {
+                endRecord(((uint64_t) blockNumber << 16) | i);
+            }
+            atLineStart = true;
+        } else if (c == '\t') {
+            ++recordTabs;
+            recordFields.push_back(c);
+        } else {
+            recordFields.push_back(c);
+        }
+    }
+}
+
+void BgzfOutput::endRecord(uint64_t stop) {
+    if (recordFields.empty() || recordFields[0] == '#') {
+        return;
+    }
+    vector<string> fields = split(recordFields, '\t');
+    if (fields.size() < 4) {
+        return;
+    }
+    long int begin = atol(fields[1].c_str()) - 1;
+    long int end = begin + fields[3].size();
+    map<string, int>::iterator s = sequenceIndexes.find(fields[0]);
+    int index;
+    if (s == sequenceIndexes.end()) {
+        index = sequences.size();
+        sequenceIndexes[fields[0]] = index;
+        sequenceNames.push_back(fields[0]);
+        sequences.push_back(TabixSequenceIndex());
+    } else {
+        index = s->second;
+    }
+    sequences[index].add(begin, end, recordStart, stop);
+}
+
+void BgzfOutput::compressPending(int i, void* output) {
+    BgzfOutput* o = (BgzfOutput*) output;
+    bgzfCompressBlock(o->pending[i], o->compressed[i]);
+}
+
+// compresses the queued blocks in parallel, and writes them in order
+void BgzfOutput::writePending(void) {
+    compressed.resize(pending.size());
+    pool->run(pending.size(), compressPending, this);
+    for (vector<string>::iterator b = compressed.begin(); b != compressed.end(); ++b) {
+        blockAddresses.push_back(address);
+        if (fwrite(b->data(), 1, b->size(), file) != b->size()) {
+            cerr << "ERROR(freebayes): could not write to " << filename << endl;
+            exit(1);
+        }
+        address += b->size();
+    }
+    pending.clear();
+    compressed.clear();
+}
+
+void BgzfOutput::close(void) {
+    if (!file) {
+        return;
+    }
+    endBlock();
+    if (!atLineStart) {
+        endRecord((uint64_t) blockNumber << 16);
+        atLineStart = true;
+    }
+    writePending();
+    // the empty block which marks the end of the file
+    string eof;
+    bgzfCompressBlock("", eof);
+    blockAddresses.push_back(address);
+    fwrite(eof.data(), 1, eof.size(), file);
+    fclose(file);
+    file = NULL;
+    writeIndex();
+    delete pool;
+    pool = NULL;
+}
+
+static void appendInt32(string& data, int32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        data.push_back((char) ((uint32_t) value >> (8 * i)));
+    }
+}
+
+static void appendUInt64(string& data, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        data.push_back((char) (value >> (8 * i)));
+    }
+}
+
+// writes FILE.tbi, converting the block numbers in the offsets to the file
+// offsets of the blocks now that all have been written
+void BgzfOutput::writeIndex(void) {
+
+    string index = "TBI\1";
+    appendInt32(index, sequences.size());
+    appendInt32(index, 2);   // VCF
+    appendInt32(index, 1);   // sequence column
+    appendInt32(index, 2);   // start column
+    appendInt32(index, 0);   // end column, which for VCF is given by the reference allele
+    appendInt32(index, '#'); // header lines
+    appendInt32(index, 0);   // lines to skip
+    string names;
+    for (vector<string>::iterator n = sequenceNames.begin(); n != sequenceNames.end(); ++n) {
+        names.append(*n);
+        names.push_back('\0');
+    }
+    appendInt32(index, names.size());
+    index.append(names);
+
+    for (vector<TabixSequenceIndex>::iterator s = sequences.begin(); s != sequences.end(); ++s) {
+        appendInt32(index, s->bins.size());
+        for (map<unsigned int, vector<pair<uint64_t, uint64_t> > >::iterator b = s->bins.begin(); b != s->bins.end(); ++b) {
+            appendInt32(index, b->first);
+            appendInt32(index, b->second.size());
+            for (vector<pair<uint64_t, uint64_t> >::iterator c = b->second.begin(); c != b->second.end(); ++c) {
+                appendUInt64(index, (blockAddresses[c->first >> 16] << 16) | (c->first & 0xffff));
+                appendUInt64(index, (blockAddresses[c->second >> 16] << 16) | (c->second & 0xffff));
+            }
+        }
+        // windows no record reaches take the offset of the window before them
+        appendInt32(index, s->linear.size());
+        uint64_t last = 0;
+        for (vector<uint64_t>::iterator l = s->linear.begin(); l != s->linear.end(); ++l) {
+            if (*l != UNSET_OFFSET) {
+                last = (blockAddresses[*l >> 16] << 16) | (*l & 0xffff);
+            }
+            appendUInt64(index, last);
+        }
+    }
+
+    string indexFileName = filename + ".tbi";
+    FILE* f = fopen(indexFileName.c_str(), "wb");
+    if (!f) {
+        cerr << "ERROR(freebayes): could not open " << indexFileName << " for writing" << endl;
+        exit(1);
+    }
+    string b;
+    for (size_t offset = 0; offset < index.size(); offset += BGZF_OUTPUT_BLOCK_SIZE) {
+        bgzfCompressBlock(index.substr(offset, BGZF_OUTPUT_BLOCK_SIZE), b);
+        fwrite(b.data(), 1, b.size(), f);
+    }
+    bgzfCompressBlock("", b);
+    fwrite(b.data(), 1, b.size(), f);
+    fclose(f);
+
+}
@@ -0,0 +1,95 @@
+#ifndef BGZFOUTPUT_H
+#define BGZFOUTPUT_H
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdio.h>
+#include <stdint.h>
+#include "TaskPool.h"
+
+using namespace std;
+
+// the uncompressed data of each output block, leaving room for incompressible
+// data to fit in a block once deflated
+#define BGZF_OUTPUT_BLOCK_SIZE 0xff00
+
+// the number of blocks compressed together for each thread of the pool
+#define BGZF_OUTPUT_BLOCKS_PER_THREAD 4
+
+// the tabix index of the VCF records of one reference sequence
+// chunks and offsets are held as virtual offsets which use the number of the
+// block in place of its file offset, as blocks are compressed out of order
+class TabixSequenceIndex {
+public:
+    map<unsigned int, vector<pair<uint64_t, uint64_t> > > bins; // chunks by bin
+    vector<uint64_t> linear; // the first record overlapping each 16kbp window
+
+    void add(long int begin, long int end, uint64_t start, uint64_t stop);
+};
+
+// a stream buffer which writes its output in BGZF, as bgzip does, with the
+// blocks compressed in parallel by a pool of threads
+//
+// the records passing through are indexed as they are written, so that on
+// closing the output a tabix index (FILE.tbi) is written alongside it
+// the records must be VCF, sorted as freebayes writes them
+class BgzfOutput : public streambuf {
+
+public:
+
+    BgzfOutput(void);
+    ~BgzfOutput(void);
+
+    bool open(const string& filename, int threads);
+
+    // writes the remaining blocks, the end of file marker and the index
+    void close(void);
+
+protected:
+
+    int overflow(int c);
+
+private:
+
+    string filename;
+    FILE* file;
+    TaskPool* pool;
+
+    char block[BGZF_OUTPUT_BLOCK_SIZE];
+    long int blockNumber;             // of the block being filled
+
+    // blocks waiting to be compressed and written
+    vector<string> pending;
+    vector<string> compressed;
+    vector<uint64_t> blockAddresses;  // file offsets of the blocks written, by number
+    uint64_t address;
+
+    // the record being read from the output
+    string recordFields;              // its first fields, up to the reference allele
+    int recordTabs;
+    uint64_t recordStart;             // its virtual offset, by block number
+    bool atLineStart;
+
+    vector<string> sequenceNames;
+    map<string, int> sequenceIndexes;
+    vector<TabixSequenceIndex> sequences;
+
+    void endBlock(void);
+    void scanBlock(int length);
+    void endRecord(uint64_t stop);
+    void writePending(void);
+    static void compressPending(int i, void* output);
+    void writeIndex(void);
+
+    BgzfOutput(const BgzfOutput&);
+    BgzfOutput& operator=(const BgzfOutput&);
+
+};
+
+// compresses data of up to BGZF_OUTPUT_BLOCK_SIZE bytes into a BGZF block
+void bgzfCompressBlock(const string& data, string& block);
+
+#endif
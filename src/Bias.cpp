@@ -30,14 +30,14 @@ void Bias::open(string& file) {
         } else {
             last = maxLength;
         }
-        long double dbias;
+        ProbFloat dbias;
         convert(fields[1], dbias);
         biases.push_back(dbias);
     }
     input.close();
 }
 
-long double Bias::bias(int length) {
+ProbFloat Bias::bias(int length) {
     if (biases.empty()) return 1; // no bias
     if (length < minLength) {
         return biases.front();
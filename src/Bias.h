@@ -8,6 +8,7 @@
 #include <vector>
 #include <cstdlib>
 #include "split.h"
+#include "Utility.h"
 
 using namespace std;
 
@@ -15,13 +16,13 @@ class Bias {
     
     int minLength;
     int maxLength;
-    vector<long double> biases;
+    vector<ProbFloat> biases;
 
 public:
 
     Bias(void) : minLength(0), maxLength(0) { }
     void open(string& file);
-    long double bias(int length);
+    ProbFloat bias(int length);
     bool empty(void);
 
 };
@@ -0,0 +1,101 @@
+#include "Checkpoint.h"
+
+bool Checkpoint::load(const string& f) {
+
+    file = f;
+
+    ifstream in(file.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+
+    string line;
+    while (getline(in, line)) {
+        stringstream fields(line);
+        string key;
+        if (!(fields >> key)) {
+            continue;
+        }
+        if (key == "units") {
+            fields >> unitCount >> signature;
+        } else if (key == "unit") {
+            string seq;
+            int left, right;
+            fields >> seq >> left >> right;
+            units.push_back(BedTarget(seq, left, right));
+        } else if (key == "targets") {
+            fields >> targetSignature;
+        } else if (key == "written") {
+            fields >> written;
+        } else if (key == "output") {
+            fields >> outputOffset;
+        } else if (key == "failed") {
+            fields >> failedOffset;
+        } else if (key == "bound") {
+            string seq;
+            long int bound;
+            fields >> seq >> bound;
+            ownedBounds[seq] = bound;
+        }
+        if (fields.fail()) {
+            cerr << "ERROR(freebayes): could not parse checkpoint file " << file << endl;
+            exit(1);
+        }
+    }
+
+    resumed = true;
+    return true;
+
+}
+
+void Checkpoint::save(void) {
+
+    string temporary = file + ".tmp";
+
+    FILE* out = fopen(temporary.c_str(), "w");
+    if (!out) {
+        cerr << "ERROR(freebayes): could not write checkpoint file " << temporary << endl;
+        exit(1);
+    }
+    fprintf(out, "units\t%d\t%lu\n", unitCount, signature);
+    fprintf(out, "targets\t%lu\n", targetSignature);
+    for (vector<BedTarget>::iterator u = units.begin(); u != units.end(); ++u) {
+        fprintf(out, "unit\t%s\t%d\t%d\n", u->seq.c_str(), u->left, u->right);
+    }
+    fprintf(out, "written\t%d\n", written);
+    fprintf(out, "output\t%ld\n", outputOffset);
+    fprintf(out, "failed\t%ld\n", failedOffset);
+    for (map<string, long int>::iterator b = ownedBounds.begin(); b != ownedBounds.end(); ++b) {
+        fprintf(out, "bound\t%s\t%ld\n", b->first.c_str(), b->second);
+    }
+    if (fflush(out) || fsync(fileno(out)) || fclose(out)) {
+        cerr << "ERROR(freebayes): could not write checkpoint file " << temporary << endl;
+        exit(1);
+    }
+
+    if (rename(temporary.c_str(), file.c_str())) {
+        cerr << "ERROR(freebayes): could not replace checkpoint file " << file << endl;
+        exit(1);
+    }
+
+}
+
+static void syncFile(const string& name) {
+    if (name.empty()) {
+        return;
+    }
+    int fd = open(name.c_str(), O_RDWR);
+    if (fd < 0 || fsync(fd) || close(fd)) {
+        cerr << "ERROR(freebayes): could not write " << name << " to disk for checkpoint" << endl;
+        exit(1);
+    }
+}
+
+void Checkpoint::syncOutputFiles(void) {
+    syncFile(outputFile);
+    syncFile(failedFile);
+}
+
+void Checkpoint::remove(void) {
+    unlink(file.c_str());
+}
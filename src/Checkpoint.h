@@ -0,0 +1,76 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "BedReader.h"
+
+using namespace std;
+
+// the minimum number of seconds between updates of the checkpoint file
+#define CHECKPOINT_INTERVAL 60
+
+// records the progress of a run through its work units, so that an
+// interrupted run can be resumed without repeating the units it completed
+//
+// the checkpoint notes the regions of the units, so that a run resumed with
+// a different --threads works through the same ones, how many units have
+// been written, the length of the
+// output files after them, and where each sequence's written records end;
+// on resuming, the output files are cut back to those lengths, and calling
+// restarts at the first unwritten unit, whose records before the recorded
+// ends are dropped as they would have been had the run not stopped
+class Checkpoint {
+
+public:
+
+    string file;
+    bool resumed;            // true if progress was loaded from the file
+
+    int unitCount;           // the number of units in the run
+    unsigned long signature; // a hash of the units' regions
+    vector<BedTarget> units; // the units' regions, reused on resuming as they depend on --threads
+    unsigned long targetSignature; // a hash of the targets the units were planned from
+    int written;             // the number of units written
+    long int outputOffset;   // the lengths of the output files
+    long int failedOffset;
+    map<string, long int> ownedBounds; // see RegionScheduler::ownedBounds
+
+    string outputFile;       // the files whose lengths are recorded, empty if not written
+    string failedFile;
+
+    Checkpoint(void)
+        : resumed(false)
+        , unitCount(0)
+        , signature(0)
+        , targetSignature(0)
+        , written(0)
+        , outputOffset(0)
+        , failedOffset(0)
+    { }
+
+    // loads progress from the file, returning false if there is none
+    bool load(const string& file);
+
+    // replaces the file with the current progress
+    // the new file is written in full before it takes the place of the old,
+    // so the file always holds a complete checkpoint
+    void save(void);
+
+    // writes the output files through to disk, once flushed, so that the
+    // lengths recorded for them can't outlive their contents in a crash
+    void syncOutputFiles(void);
+
+    // removes the file once the run is complete
+    void remove(void);
+
+};
+
+#endif
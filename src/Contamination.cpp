@@ -64,7 +64,7 @@ double Contamination::refBias(string& sample) {
     }
 }
 
-ContaminationEstimate& Contamination::of(string& sample) {
+ContaminationEstimate& Contamination::of(const string& sample) {
     Contamination::iterator s = find(sample);
     if (s != end()) {
         return s->second;
@@ -73,4 +73,19 @@ ContaminationEstimate& Contamination::of(string& sample) {
     }
 }
 
+void Contamination::indexReadGroups(const vector<string>& readGroups) {
+    readGroupEstimates.clear();
+    for (vector<string>::const_iterator r = readGroups.begin(); r != readGroups.end(); ++r) {
+        readGroupEstimates.push_back(&of(*r));
+    }
+}
+
+ContaminationEstimate& Contamination::of(int readGroupIndex, const string& readGroup) {
+    if (readGroupIndex >= 0 && readGroupIndex < (int) readGroupEstimates.size()) {
+        return *readGroupEstimates[readGroupIndex];
+    } else {
+        return of(readGroup);
+    }
+}
+
 #endif
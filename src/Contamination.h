@@ -31,7 +31,12 @@ public:
     double probRefGivenHet(string& sample);
     double probRefGivenHomAlt(string& sample);
     double refBias(string& sample);
-    ContaminationEstimate& of(string& sample);
+    ContaminationEstimate& of(const string& sample);
+    // the estimates for the read groups in the order the parser indexes them,
+    // so that observations find theirs without a search by name
+    vector<ContaminationEstimate*> readGroupEstimates;
+    void indexReadGroups(const vector<string>& readGroups);
+    ContaminationEstimate& of(int readGroupIndex, const string& readGroup);
 Contamination(void) : defaultEstimate(ContaminationEstimate(0.5, 0)) { }
 Contamination(double ra, double aa) : defaultEstimate(ContaminationEstimate(ra, aa)) { }
 };
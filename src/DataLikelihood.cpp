@@ -3,182 +3,228 @@
 #include "multipermute.h"
 
 
-long double
-probObservedAllelesGivenGenotype(
+// the probability of an observation, given the genotype allele it was sampled
+// from, for each genotype allele in turn
+static void addObservationRow(vector<double>& row, int alleleCount, const vector<int>& supported,
+                              ProbFloat supportedProb, ProbFloat unsupportedProb) {
+    int start = row.size();
+    row.resize(start + alleleCount, unsupportedProb);
+    for (vector<int>::const_iterator j = supported.begin(); j != supported.end(); ++j) {
+        row[start + *j] = supportedProb;
+    }
+}
+
+SampleObservationTerms::SampleObservationTerms(
         Sample& sample,
-        Genotype& genotype,
-        double dependenceFactor,
-        bool useMapQ,
-        Bias& observationBias,
-        bool standardGLs,
         vector<Allele>& genotypeAlleles,
-        Contamination& contaminations,
-        map<string, double>& freqs
-    ) {
+        Contamination& contaminationEstimates
+    ) : countIn(0) {
 
-    int observationCount = sample.observationCount();
-    vector<long double> alleleProbs = genotype.alleleProbabilities(observationBias);
-    vector<int> observationCounts = genotype.alleleObservationCounts(sample);
-    int countOut = 0;
-    double countIn = 0;
-    long double prodQout = 0;  // the probability that the reads not in the genotype are all wrong
-    long double probObsGivenGt = 0;
-    
-    if (standardGLs) {
-        for (Sample::iterator s = sample.begin(); s != sample.end(); ++s) {
-            const string& base = s->first;
-            if (!genotype.containsAllele(base)) {
-                vector<Allele*>& alleles = s->second;
-                if (useMapQ) {
-                    for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
-                        // take the lesser of mapping quality and base quality (in log space)
-                        prodQout += max((*a)->lnquality, (*a)->lnmapQuality);
-                    }
+    for (vector<Allele>::iterator b = genotypeAlleles.begin(); b != genotypeAlleles.end(); ++b) {
+        isReference.push_back(b->isReference());
+    }
+
+    // every observation of the sample is counted: those of each genotype
+    // allele support it alone, those of other alleles support none, and each
+    // partial observation supports the genotype alleles it was assigned to,
+    // once for each with its probabilities scaled by their number
+    int alleleCount = genotypeAlleles.size();
+    vector<vector<double> > rows; // the probabilities of each group, observation by observation
+    vector<int> supported;
+    for (int k = -1; k < (int) sample.alleleObservations.size(); ++k) {
+        vector<Allele*>& alleles = (k < 0) ? sample.otherObservations : sample.alleleObservations[k];
+        supported.clear();
+        if (k >= 0) {
+            supported.push_back(k);
+        }
+        for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
+            Allele& obs = **a;
+            int g = observationGroup(obs, contaminationEstimates, rows);
+            // note that this will underflow if we have mapping quality = 0
+            // we guard against this externally, by ignoring such alignments (quality has to be > MQL0)
+            ProbFloat qual = (1 - exp(obs.lnquality)) * (1 - exp(obs.lnmapQuality));
+            addObservationRow(rows[g], alleleCount, supported, qual, 1 - qual);
+            if (k >= 0) {
+                countIn += 1;
+            }
+            ++groups[g].count;
+        }
+    }
+
+    for (vector<PartialObservation>::iterator p = sample.partialObservations.begin();
+         p != sample.partialObservations.end(); ++p) {
+        Allele& obs = *p->allele;
+        int g = observationGroup(obs, contaminationEstimates, rows);
+        ProbFloat qual = (1 - exp(obs.lnquality)) * (1 - exp(obs.lnmapQuality));
+        // distribute partial support evenly across supported haplotypes
+        double scale = (double) 1 / (double) p->supportCount;
+        for (int i = 0; i < p->supportCount; ++i) {
+            addObservationRow(rows[g], alleleCount, p->supported, qual * scale, (1 - qual) * scale);
+            if (!p->supported.empty()) {
+                countIn += scale;
+            }
+            ++groups[g].count;
+        }
+    }
+
+    // transpose, so the kernel reads each allele's probabilities contiguously
+    for (int g = 0; g < (int) groups.size(); ++g) {
+        ObservationGroup& group = groups[g];
+        group.probs.resize(rows[g].size());
+        for (int i = 0; i < group.count; ++i) {
+            for (int j = 0; j < alleleCount; ++j) {
+                group.probs[j * group.count + i] = rows[g][i * alleleCount + j];
+            }
+        }
+    }
+
+}
+
+// the group of observations sharing the contamination estimate of obs,
+// which is added if there is none yet
+int SampleObservationTerms::observationGroup(Allele& obs, Contamination& contaminationEstimates,
+                                             vector<vector<double> >& rows) {
+    ContaminationEstimate* contamination = &contaminationEstimates.of(obs.readGroupIndex, *obs.readGroupID);
+    int g = 0;
+    while (g < (int) groups.size() && groups[g].contamination != contamination) {
+        ++g;
+    }
+    if (g == (int) groups.size()) {
+        groups.push_back(ObservationGroup(contamination));
+        rows.push_back(vector<double>());
+    }
+    return g;
+}
+
+ProbFloat SampleObservationTerms::probObservationsGivenGenotype(Genotype& genotype, double dependenceFactor) {
+
+    int alleleCount = isReference.size();
+    if (alleleCount == 0) {
+        return 0;
+    }
+
+    // the fraction of the genotype made up by each genotype allele
+    vector<double> genotypeProbs(alleleCount, 0);
+    for (Genotype::iterator e = genotype.begin(); e != genotype.end(); ++e) {
+        genotypeProbs[e->alleleIndex] = (double) e->count / (double) genotype.ploidy;
+    }
+
+    vector<double> samplingProbs(alleleCount);
+    ProbFloat probObsGivenGt = 0;
+    for (vector<ObservationGroup>::iterator o = groups.begin(); o != groups.end(); ++o) {
+        ContaminationEstimate& contamination = *o->contamination;
+        // the probability of sampling each genotype allele, given the
+        // contamination estimate of the group
+        for (int j = 0; j < alleleCount; ++j) {
+            double asampl = genotypeProbs[j];
+            if (asampl == 0) {
+                // scale by frequency of (this) possibly contaminating allele
+                asampl = contamination.probRefGivenHomAlt;
+            } else if (asampl == 1) {
+                // scale by frequency of (other) possibly contaminating alleles
+                asampl = 1 - contamination.probRefGivenHomAlt;
+            } else {
+                // to deal with polyploids
+                // note that this reduces to 1 for diploid heterozygotes
+                double scale = asampl / 0.5;
+                // this term captures reference bias
+                if (isReference[j]) {
+                    asampl = scale * contamination.probRefGivenHet;
                 } else {
-                    for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
-                        prodQout += (*a)->lnquality;
-                    }
+                    asampl = 1 - (scale * contamination.probRefGivenHet);
                 }
-                countOut += alleles.size();
             }
+            samplingProbs[j] = asampl;
         }
-    } else {
-        // problem.
-        // we should do this over all alleles
-        // which have partial support or full support.
-        // this is only over
-        vector<Allele*> emptyA;
-        vector<Allele*> emptyB;
-        for (set<string>::iterator c = sample.supportedAlleles.begin();
-             c != sample.supportedAlleles.end(); ++c) {
-
-            vector<Allele*>* alleles = &emptyA;
-            Sample::iterator si = sample.find(*c);
-            if (si != sample.end()) alleles = &si->second;
-
-            vector<Allele*>* partials = &emptyB;
-            map<string, vector<Allele*> >::iterator pi = sample.partialSupport.find(*c);
-            if (pi != sample.partialSupport.end()) partials = &pi->second;
-
-            bool onPartials = false;
-            vector<Allele*>::iterator a = alleles->begin();
-            bool hasPartials = !partials->empty();
-            for ( ; (!hasPartials && a != alleles->end()) || a != partials->end(); ++a) {
-                if (a == alleles->end()) {
-                    if (hasPartials) {
-                        a = partials->begin();
-                        onPartials = true;
-                    } else {
-                        break;
-                    }
-                }
-                Allele& obs = **a;
-                long double probi = 0;
-                ContaminationEstimate& contamination = contaminations.of(obs.readGroupID);
-                double scale = 1;
-                // note that this will underflow if we have mapping quality = 0
-                // we guard against this externally, by ignoring such alignments (quality has to be > MQL0)
-                long double qual = (1 - exp(obs.lnquality)) * (1 - exp(obs.lnmapQuality));
-                if (onPartials) {
-                    map<Allele*, set<Allele*> >::iterator r = sample.reversePartials.find(*a);
-                    if (r != sample.reversePartials.end()) {
-                        if (sample.reversePartials[*a].empty()) {
-                            cerr << "partial " << *a << " has empty reverse" << endl;
-                            exit(1);
-                        }
-                        //cerr << "partial " << *a << " supports potentially " << sample.reversePartials[*a].size() << " alleles : ";
-                        //for (set<Allele*>::iterator m = sample.reversePartials[*a].begin();
-                        //     m != sample.reversePartials[*a].end(); ++m) cerr << **m << " ";
-                        //cerr << endl;
-                        scale = (double)1/(double)sample.reversePartials[*a].size();
-                    }
-                }
+        probObsGivenGt += sumLogObservationProbs(&o->probs[0], alleleCount, o->count, &samplingProbs[0]);
+    }
 
-                // TODO add partial obs, now that we have them recorded
-                // how does this work?
-                // each partial obs is recorded as supporting, but with observation probability scaled by the number of possible haplotypes it supports
-                bool isInGenotype = false;
-
-                for (vector<Allele>::iterator b = genotypeAlleles.begin(); b != genotypeAlleles.end(); ++b) {
-                    Allele& allele = *b;
-                    const string& base = b->currentBase;
-
-                    long double q;
-                    if (obs.currentBase == base
-                        || (onPartials && sample.observationSupports(*a, &*b))) {
-                        isInGenotype = true;
-                        q = qual;
-                    } else {
-                        q = 1 - qual;
-                    }
-
-                    if (onPartials) {
-                        q *= scale; // distribute partial support evenly across supported haplotypes
-                    }
-
-                    double asampl = genotype.alleleSamplingProb(base);
-                    //double freq = freqs[base];
-
-                    if (asampl == 0) {
-                        // scale by frequency of (this) possibly contaminating allele
-                        asampl = contamination.probRefGivenHomAlt;
-                    } else if (asampl == 1) {
-                        // scale by frequency of (other) possibly contaminating alleles
-                        asampl = 1 - contamination.probRefGivenHomAlt;
-                    } else {
-                        // to deal with polyploids
-                        // note that this reduces to 1 for diploid heterozygotes
-                        double scale = asampl / 0.5;
-                        // this term captures reference bias
-                        if (allele.isReference()) {
-                            asampl = scale * contamination.probRefGivenHet;
-                        } else {
-                            asampl = 1 - (scale * contamination.probRefGivenHet);
-                        }
-                    }
-
-                    probi += asampl * q;
+    // read dependence factor, but inverted to deal with the new GL implementation
+    if (countIn > 1) {
+        probObsGivenGt *= (1 + (countIn - 1) * dependenceFactor) / countIn;
+    }
+    //cerr << "P(obs|" << genotype << ") = " << probObsGivenGt << endl;
+    return isinf(probObsGivenGt) ? 0 : probObsGivenGt;
 
-                }
+}
 
-                if (isInGenotype) {
-                    countIn += scale;
-                }
+// the likelihood used with --standard-gls
+static ProbFloat
+probObservedAllelesGivenGenotypeStandard(
+        Sample& sample,
+        Genotype& genotype,
+        double dependenceFactor,
+        bool useMapQ,
+        Bias& observationBias
+    ) {
+
+    vector<ProbFloat> alleleProbs = genotype.alleleProbabilities(observationBias);
+    vector<int> observationCounts = genotype.alleleObservationCounts(sample);
+    int countOut = 0;
+    ProbFloat prodQout = 0;  // the probability that the reads not in the genotype are all wrong
+
+    vector<bool> inGenotype(sample.alleleObservations.size(), false);
+    for (Genotype::iterator e = genotype.begin(); e != genotype.end(); ++e) {
+        if (e->alleleIndex < (int) inGenotype.size()) {
+            inGenotype[e->alleleIndex] = true;
+        }
+    }
 
-                // bound to (0,1]
-                if (probi > 0) {
-                    long double lnprobi = log(min(probi, (long double) 1.0));
-                    probObsGivenGt += lnprobi;
+    for (int k = -1; k < (int) sample.alleleObservations.size(); ++k) {
+        if (k < 0 || !inGenotype[k]) {
+            vector<Allele*>& alleles = (k < 0) ? sample.otherObservations : sample.alleleObservations[k];
+            if (useMapQ) {
+                for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
+                    // take the lesser of mapping quality and base quality (in log space)
+                    prodQout += max((*a)->lnquality, (*a)->lnmapQuality);
+                }
+            } else {
+                for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
+                    prodQout += (*a)->lnquality;
                 }
             }
+            countOut += alleles.size();
         }
     }
 
     // read dependence factor, asymptotically downgrade quality values of
     // successive reads to dependenceFactor * quality
-    if (standardGLs) {
-        if (countOut > 1) {
-            prodQout *= (1 + (countOut - 1) * dependenceFactor) / countOut;
-        }
+    if (countOut > 1) {
+        prodQout *= (1 + (countOut - 1) * dependenceFactor) / countOut;
+    }
 
-        if (sum(observationCounts) == 0) {
-            return prodQout;
-        } else {
-            return prodQout + multinomialSamplingProbLn(alleleProbs, observationCounts);
-        }
+    if (sum(observationCounts) == 0) {
+        return prodQout;
     } else {
-        // read dependence factor, but inverted to deal with the new GL implementation
-        if (countIn > 1) {
-            probObsGivenGt *= (1 + (countIn - 1) * dependenceFactor) / countIn;
-        }
-        //cerr << "P(obs|" << genotype << ") = " << probObsGivenGt << endl;
-        return isinf(probObsGivenGt) ? 0 : probObsGivenGt;
+        return prodQout + multinomialSamplingProbLn(alleleProbs, observationCounts);
     }
 
 }
 
+ProbFloat
+probObservedAllelesGivenGenotype(
+        Sample& sample,
+        Genotype& genotype,
+        double dependenceFactor,
+        bool useMapQ,
+        Bias& observationBias,
+        bool standardGLs,
+        vector<Allele>& genotypeAlleles,
+        Contamination& contaminations,
+        vector<double>& freqs
+    ) {
 
-vector<pair<Genotype*, long double> >
+    if (standardGLs) {
+        return probObservedAllelesGivenGenotypeStandard(sample, genotype, dependenceFactor, useMapQ, observationBias);
+    } else {
+        SampleObservationTerms terms(sample, genotypeAlleles, contaminations);
+        return terms.probObservationsGivenGenotype(genotype, dependenceFactor);
+    }
+
+}
+
+
+vector<pair<Genotype*, ProbFloat> >
 probObservedAllelesGivenGenotypes(
         Sample& sample,
         vector<Genotype*>& genotypes,
@@ -188,22 +234,26 @@ probObservedAllelesGivenGenotypes(
         bool standardGLs,
         vector<Allele>& genotypeAlleles,
         Contamination& contaminations,
-        map<string, double>& freqs
+        vector<double>& freqs
     ) {
-    vector<pair<Genotype*, long double> > results;
-    for (vector<Genotype*>::iterator g = genotypes.begin(); g != genotypes.end(); ++g) {
-        results.push_back(
-	    make_pair(*g,
-                  probObservedAllelesGivenGenotype(
-                      sample,
-                      **g,
-                      dependenceFactor,
-                      useMapQ,
-                      observationBias,
-                      standardGLs,
-                      genotypeAlleles,
-                      contaminations,
-                      freqs)));
+    vector<pair<Genotype*, ProbFloat> > results;
+    if (standardGLs) {
+        for (vector<Genotype*>::iterator g = genotypes.begin(); g != genotypes.end(); ++g) {
+            results.push_back(
+                make_pair(*g,
+                          probObservedAllelesGivenGenotypeStandard(
+                              sample,
+                              **g,
+                              dependenceFactor,
+                              useMapQ,
+                              observationBias)));
+        }
+    } else {
+        // the observation terms are shared by every genotype of the sample
+        SampleObservationTerms terms(sample, genotypeAlleles, contaminations);
+        for (vector<Genotype*>::iterator g = genotypes.begin(); g != genotypes.end(); ++g) {
+            results.push_back(make_pair(*g, terms.probObservationsGivenGenotype(**g, dependenceFactor)));
+        }
     }
     return results;
 }
@@ -17,10 +17,49 @@
 #include "Dirichlet.h"
 #include "Bias.h"
 #include "Contamination.h"
+#include "LikelihoodKernel.h"
 
 using namespace std;
 
-long double
+// the observations of a sample whose read groups share a contamination
+// estimate, laid out for the likelihood kernel: for each genotype allele in
+// turn, the probability of each observation if it was sampled from the allele
+class ObservationGroup {
+public:
+    ContaminationEstimate* contamination;
+    int count;
+    vector<double> probs;  // genotype alleles x observations
+
+    ObservationGroup(ContaminationEstimate* c)
+        : contamination(c)
+        , count(0)
+    { }
+};
+
+// the observations of a sample at a site, reduced once to what the data
+// likelihood of each genotype needs: their quality terms, the genotype
+// alleles each supports, and their read group's contamination estimate
+//
+// each genotype's likelihood is then a sum over these arrays, without
+// revisiting the sample's alleles, partials or quality values
+class SampleObservationTerms {
+public:
+    vector<ObservationGroup> groups;
+    vector<bool> isReference;      // of each genotype allele
+    double countIn;                // observations supporting any genotype allele, weighted for partials
+
+    // the sample's observations must be grouped by the genotype alleles
+    SampleObservationTerms(Sample& sample,
+                           vector<Allele>& genotypeAlleles,
+                           Contamination& contaminationEstimates);
+
+    ProbFloat probObservationsGivenGenotype(Genotype& genotype, double dependenceFactor);
+
+private:
+    int observationGroup(Allele& obs, Contamination& contaminationEstimates, vector<vector<double> >& rows);
+};
+
+ProbFloat
 probObservedAllelesGivenGenotype(
         Sample& sample,
         Genotype& genotype,
@@ -30,9 +69,9 @@ probObservedAllelesGivenGenotype(
         bool standardGLs,
         vector<Allele>& genotypeAlleles,
         Contamination& contaminations,
-        map<string, double>& freqs);
+        vector<double>& freqs);
 
-vector<pair<Genotype*, long double> >
+vector<pair<Genotype*, ProbFloat> >
 probObservedAllelesGivenGenotypes(
         Sample& sample,
         vector<Genotype*>& genotypes,
@@ -42,6 +81,6 @@ probObservedAllelesGivenGenotypes(
         bool standardGLs,
         vector<Allele>& genotypeAlleles,
         Contamination& contaminations,
-        map<string, double>& freqs);
+        vector<double>& freqs);
 
 #endif
@@ -2,7 +2,7 @@
 #include "Utility.h"
 #include "Sum.h"
 
-long double dirichletMaximumLikelihoodRatio(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
-long double dirichlet(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
-long double dirichletMaximumLikelihoodRatioln(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
-long double dirichletln(const vector<long double>& probs, const vector<int>& obs, long double s = (long double) 1.0);
+ProbFloat dirichletMaximumLikelihoodRatio(const vector<ProbFloat>& probs, const vector<int>& obs, ProbFloat s = (ProbFloat) 1.0);
+ProbFloat dirichlet(const vector<ProbFloat>& probs, const vector<int>& obs, ProbFloat s = (ProbFloat) 1.0);
+ProbFloat dirichletMaximumLikelihoodRatioln(const vector<ProbFloat>& probs, const vector<int>& obs, ProbFloat s = (ProbFloat) 1.0);
+ProbFloat dirichletln(const vector<ProbFloat>& probs, const vector<int>& obs, ProbFloat s = (ProbFloat) 1.0);
@@ -6,16 +6,16 @@ using namespace std;
 
 // genotype priors
 
-long double alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, long double theta);
-long double alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta);
-long double __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta);
+ProbFloat alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, ProbFloat theta);
+ProbFloat alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, ProbFloat theta);
+ProbFloat __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, ProbFloat theta);
 
-class AlleleFrequencyProbabilityCache : public map<map<int, int>, long double> {
+class AlleleFrequencyProbabilityCache : public map<map<int, int>, ProbFloat> {
 public:
-    long double alleleFrequencyProbabilityln(const map<int, int>& counts, long double theta) {
-        map<map<int, int>, long double>::iterator p = find(counts);
+    ProbFloat alleleFrequencyProbabilityln(const map<int, int>& counts, ProbFloat theta) {
+        map<map<int, int>, ProbFloat>::iterator p = find(counts);
         if (p == end()) {
-            long double pln = __alleleFrequencyProbabilityln(counts, theta);
+            ProbFloat pln = __alleleFrequencyProbabilityln(counts, theta);
             insert(make_pair(counts, pln));
             return pln;
         } else {
@@ -7,6 +7,8 @@
 // ---------------------------------------------------------------------------
 
 #include "Fasta.h"
+#include "BGZF.h"
+#include <climits>
 
 FastaIndexEntry::FastaIndexEntry(string name, int length, long long offset, int line_blen, int line_len)
     : name(name)
@@ -204,7 +206,7 @@ FastaIndex::~FastaIndex(void) {
     indexFile.close();
 }
 
-FastaIndexEntry FastaIndex::entry(string name) {
+FastaIndexEntry& FastaIndex::entry(const string& name) {
     FastaIndex::iterator e = this->find(name);
     if (e == this->end()) {
         cerr << "unable to find FASTA index entry for '" << name << "'" << endl;
@@ -216,10 +218,13 @@ FastaIndexEntry FastaIndex::entry(string name) {
 
 string FastaIndex::indexFileExtension() { return ".fai"; }
 
-/*
-FastaReference::FastaReference(string reffilename) {
-}
-*/
+FastaReference::FastaReference(void)
+    : file(NULL)
+    , index(NULL)
+    , mapped(NULL)
+    , mappedSize(0)
+    , compressed(NULL)
+{}
 
 void FastaReference::open(string reffilename) {
     filename = reffilename;
@@ -227,12 +232,21 @@ void FastaReference::open(string reffilename) {
         cerr << "could not open " << filename << endl;
         exit(1);
     }
+    compressed = new CompressedFasta;
+    if (!compressed->open(filename)) {
+        delete compressed;
+        compressed = NULL;
+        mapFile();
+    }
     index = new FastaIndex();
     struct stat stFileInfo; 
     string indexFileName = filename + index->indexFileExtension(); 
     // if we can find an index file, use it
     if(stat(indexFileName.c_str(), &stFileInfo) == 0) { 
         index->readIndexFile(indexFileName);
+    } else if (compressed) {
+        cerr << "index file " << indexFileName << " not found; compressed references must be indexed, as with samtools faidx" << endl;
+        exit(1);
     } else { // otherwise, read the reference and generate the index file in the cwd
         cerr << "index file " << indexFileName << " not found, generating..." << endl;
         index->indexReference(filename);
@@ -240,13 +254,40 @@ void FastaReference::open(string reffilename) {
     }
 }
 
+// maps the reference into memory, so that subsequences are copied straight
+// out of the page cache instead of through a seek, a read and a temporary
+// buffer for every request
+void FastaReference::mapFile(void) {
+    struct stat stFileInfo;
+    if (fstat(fileno(file), &stFileInfo) != 0 || stFileInfo.st_size == 0) {
+        return;
+    }
+    void* m = mmap(NULL, stFileInfo.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+    if (m == MAP_FAILED) {
+        return;
+    }
+    mapped = (char*) m;
+    mappedSize = stFileInfo.st_size;
+}
+
 FastaReference::~FastaReference(void) {
-    fclose(file);
+    if (mapped) {
+        munmap(mapped, mappedSize);
+    }
+    if (file) {
+        fclose(file);
+    }
+    delete compressed;
     delete index;
 }
 
-string FastaReference::getSequence(string seqname) {
-    FastaIndexEntry entry = index->entry(seqname);
+string FastaReference::getSequence(const string& seqname) {
+    FastaIndexEntry& entry = index->entry(seqname);
+    if (mapped || compressed) {
+        string s;
+        readSubSequence(entry, 0, entry.length, s);
+        return s;
+    }
     int newlines_in_sequence = entry.length / entry.line_blen;
     int seqlen = newlines_in_sequence  + entry.length;
     char* seq = (char*) calloc (seqlen + 1, sizeof(char));
@@ -273,11 +314,22 @@ string FastaReference::sequenceNameStartingWith(string seqnameStart) {
     }
 }
 
-string FastaReference::getSubSequence(string seqname, int start, int length) {
-    FastaIndexEntry entry = index->entry(seqname);
+string FastaReference::getSubSequence(const string& seqname, int start, int length) {
+    string s;
+    getSubSequence(seqname, start, length, s);
+    return s;
+}
+
+void FastaReference::getSubSequence(const string& seqname, int start, int length, string& sequence) {
+    sequence.clear();
+    FastaIndexEntry& entry = index->entry(seqname);
     length = min(length, entry.length - start);
     if (start < 0 || length < 1) {
-        return "";
+        return;
+    }
+    if (mapped || compressed) {
+        readSubSequence(entry, start, length, sequence);
+        return;
     }
     // we have to handle newlines
     // approach: count newlines before start
@@ -295,14 +347,187 @@ string FastaReference::getSubSequence(string seqname, int start, int length) {
     char* pend = seq + (seqlen/sizeof(char));
     pend = remove(pbegin, pend, '\n');
     pend = remove(pbegin, pend, '\0');
-    string s = seq;
+    sequence.assign(pbegin, pend);
     free(seq);
-    s.resize((pend - pbegin)/sizeof(char));
-    return s;
 }
 
-long unsigned int FastaReference::sequenceLength(string seqname) {
-    FastaIndexEntry entry = index->entry(seqname);
-    return entry.length;
+// reads the subsequence from the mapping, or from the compressed reference by
+// way of the raw lines which hold it
+void FastaReference::readSubSequence(const FastaIndexEntry& entry, int start, int length, string& sequence) {
+    if (mapped) {
+        readSubSequence(entry, start, length, sequence, mapped, 0, mappedSize);
+        return;
+    }
+    int last = start + length - 1;
+    long long first = entry.offset + (long long) (start / entry.line_blen) * entry.line_len + start % entry.line_blen;
+    long long end = entry.offset + (long long) (last / entry.line_blen) * entry.line_len + last % entry.line_blen + 1;
+    compressedData.clear();
+    compressed->read(first, end - first, compressedData);
+    readSubSequence(entry, start, length, sequence, compressedData.data(), first, compressedData.size());
+}
+
+// copies the bases of the sequence a line at a time, skipping the line
+// terminators by way of the line layout recorded in the index
+// data holds dataSize bytes of the file from dataOffset
+void FastaReference::readSubSequence(const FastaIndexEntry& entry, int start, int length, string& sequence,
+                                     const char* data, long long dataOffset, long long dataSize) {
+    sequence.reserve(length);
+    long long line = start / entry.line_blen;
+    int column = start % entry.line_blen;
+    while (length > 0) {
+        long long offset = entry.offset + line * entry.line_len + column - dataOffset;
+        if (offset < 0 || offset >= dataSize) {
+            break;
+        }
+        int n = min(min(entry.line_blen - column, length), (int) (dataSize - offset));
+        sequence.append(data + offset, n);
+        length -= n;
+        column = 0;
+        ++line;
+    }
 }
 
+CompressedFasta::CompressedFasta(void)
+    : bgzf(NULL)
+    , uses(0)
+{ }
+
+CompressedFasta::~CompressedFasta(void) {
+    if (bgzf) {
+        bgzf->Close();
+        delete bgzf;
+    }
+}
+
+bool CompressedFasta::open(string filename) {
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    char header[BamTools::BLOCK_HEADER_LENGTH];
+    bool isBgzf = fread(header, 1, sizeof(header), f) == sizeof(header)
+        && BamTools::BgzfData::CheckBlockHeader(header);
+    fclose(f);
+    if (!isBgzf) {
+        return false;
+    }
+    bgzf = new BamTools::BgzfData;
+    if (!bgzf->Open(filename, "rb")) {
+        cerr << "could not open " << filename << endl;
+        exit(1);
+    }
+    if (!readIndex(filename + ".gzi")) {
+        cerr << "index file " << filename << ".gzi not found, scanning the compressed blocks" << endl;
+        scanBlocks();
+    }
+    cache.resize(COMPRESSED_FASTA_CACHED_BLOCKS);
+    return true;
+}
+
+// the .gzi index holds a count, then the compressed and uncompressed offsets
+// of each block after the first, all as little-endian 64-bit integers
+bool CompressedFasta::readIndex(string indexFileName) {
+    FILE* f = fopen(indexFileName.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    blocks.clear();
+    blocks.push_back(make_pair(0LL, 0LL));
+    char buffer[16];
+    bool ok = fread(buffer, 1, 8, f) == 8;
+    uint64_t count = 0;
+    for (int i = 7; ok && i >= 0; --i) {
+        count = (count << 8) | (unsigned char) buffer[i];
+    }
+    for (uint64_t b = 0; ok && b < count; ++b) {
+        ok = fread(buffer, 1, 16, f) == 16;
+        uint64_t coffset = 0;
+        uint64_t uoffset = 0;
+        for (int i = 7; ok && i >= 0; --i) {
+            coffset = (coffset << 8) | (unsigned char) buffer[i];
+            uoffset = (uoffset << 8) | (unsigned char) buffer[8 + i];
+        }
+        if (ok) {
+            blocks.push_back(make_pair((long long) uoffset, (long long) coffset));
+        }
+    }
+    fclose(f);
+    if (!ok) {
+        cerr << "could not read compressed FASTA index " << indexFileName << endl;
+        exit(1);
+    }
+    return true;
+}
+
+// builds the block offsets from the block sizes in the headers and the
+// uncompressed sizes in the footers, without decompressing anything
+void CompressedFasta::scanBlocks(void) {
+    blocks.clear();
+    FILE* f = bgzf->Stream;
+    long long coffset = 0;
+    long long uoffset = 0;
+    char header[BamTools::BLOCK_HEADER_LENGTH];
+    while (fseek64(f, coffset, SEEK_SET) == 0
+           && fread(header, 1, sizeof(header), f) == sizeof(header)
+           && BamTools::BgzfData::CheckBlockHeader(header)) {
+        int blockLength = BamTools::BgzfData::UnpackUnsignedShort(&header[16]) + 1;
+        char footer[4];
+        if (fseek64(f, coffset + blockLength - 4, SEEK_SET) != 0
+            || fread(footer, 1, 4, f) != 4) {
+            break;
+        }
+        blocks.push_back(make_pair(uoffset, coffset));
+        uoffset += BamTools::BgzfData::UnpackUnsignedInt(footer);
+        coffset += blockLength;
+    }
+}
+
+// the decompressed data of the block at the given file offset, from the cache
+// if it holds it, otherwise replacing the least recently used block
+const string& CompressedFasta::block(long long address) {
+    vector<CachedBlock>::iterator oldest = cache.begin();
+    for (vector<CachedBlock>::iterator c = cache.begin(); c != cache.end(); ++c) {
+        if (c->address == address) {
+            c->lastUse = ++uses;
+            return c->data;
+        }
+        if (c->lastUse < oldest->lastUse) {
+            oldest = c;
+        }
+    }
+    int length = bgzf->ReadBlockAt(address);
+    if (length < 0) {
+        cerr << "could not read compressed reference block at " << address << endl;
+        exit(1);
+    }
+    oldest->address = address;
+    oldest->data.assign(bgzf->UncompressedBlock, length);
+    oldest->lastUse = ++uses;
+    return oldest->data;
+}
+
+void CompressedFasta::read(long long offset, long long length, string& data) {
+    // the last block starting at or before the offset
+    vector<pair<long long, long long> >::iterator b =
+        upper_bound(blocks.begin(), blocks.end(), make_pair(offset, LLONG_MAX));
+    if (b == blocks.begin()) {
+        return;
+    }
+    --b;
+    while (length > 0 && b != blocks.end()) {
+        const string& d = block(b->second);
+        long long from = offset - b->first;
+        if (from >= 0 && from < (long long) d.size()) {
+            long long n = min(length, (long long) d.size() - from);
+            data.append(d, from, n);
+            offset += n;
+            length -= n;
+        }
+        ++b;
+    }
+}
+
+long unsigned int FastaReference::sequenceLength(const string& seqname) {
+    FastaIndexEntry& entry = index->entry(seqname);
+    return entry.length;
+}
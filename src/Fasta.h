@@ -22,9 +22,19 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 using namespace std;
 
+namespace BamTools {
+    struct BgzfData;
+}
+
+// the number of decompressed blocks kept by CompressedFasta; the parser reads
+// the reference mostly in order, so a few suffice
+#define COMPRESSED_FASTA_CACHED_BLOCKS 8
+
 class FastaIndexEntry {
     friend ostream& operator<<(ostream& output, const FastaIndexEntry& e);
     public:
@@ -49,25 +59,72 @@ class FastaIndex : public map<string, FastaIndexEntry> {
         void readIndexFile(string fname);
         void writeIndexFile(string fname);
         ifstream indexFile;
-        FastaIndexEntry entry(string key);
+        FastaIndexEntry& entry(const string& key);
         void flushEntryToIndex(FastaIndexEntry& entry);
         string indexFileExtension(void);
 };
 
+// reads a bgzip-compressed FASTA by offset in the uncompressed file
+// the blocks are located through the .gzi index written by bgzip -i or
+// samtools faidx, or if there is none, by scanning the block headers
+class CompressedFasta {
+    public:
+        CompressedFasta(void);
+        ~CompressedFasta(void);
+        // true if the file is in BGZF, in which case it is opened
+        bool open(string filename);
+        // appends length bytes of the uncompressed file from offset to data
+        void read(long long offset, long long length, string& data);
+    private:
+        class CachedBlock {
+            public:
+                long long address;
+                string data;
+                unsigned long lastUse;
+                CachedBlock(void) : address(-1), lastUse(0) { }
+        };
+        BamTools::BgzfData* bgzf;
+        // the uncompressed and compressed offsets of the start of each block
+        vector<pair<long long, long long> > blocks;
+        vector<CachedBlock> cache;
+        unsigned long uses;
+        bool readIndex(string indexFileName);
+        void scanBlocks(void);
+        const string& block(long long address);
+        CompressedFasta(const CompressedFasta&);
+        CompressedFasta& operator=(const CompressedFasta&);
+};
+
 class FastaReference {
     public:
+        FastaReference(void);
         void open(string reffilename);
         string filename;
         ~FastaReference(void);
         FILE* file;
         FastaIndex* index;
+        // the reference file mapped into memory, or NULL if it could not be,
+        // in which case sequence is read through the file
+        char* mapped;
+        size_t mappedSize;
+        // set if the reference is bgzip-compressed, in which case it is
+        // neither mapped nor read through the file
+        CompressedFasta* compressed;
         vector<FastaIndexEntry> findSequencesStartingWith(string seqnameStart);
-        string getSequence(string seqname);
-        // potentially useful for performance, investigate
-        // void getSequence(string seqname, string& sequence);
-        string getSubSequence(string seqname, int start, int length);
+        string getSequence(const string& seqname);
+        string getSubSequence(const string& seqname, int start, int length);
+        // writes the subsequence into the given string, reusing its storage
+        void getSubSequence(const string& seqname, int start, int length, string& sequence);
         string sequenceNameStartingWith(string seqnameStart);
-        long unsigned int sequenceLength(string seqname);
+        long unsigned int sequenceLength(const string& seqname);
+    private:
+        void mapFile(void);
+        string compressedData; // the raw lines of a subsequence read from a compressed reference
+        void readSubSequence(const FastaIndexEntry& entry, int start, int length, string& sequence);
+        void readSubSequence(const FastaIndexEntry& entry, int start, int length, string& sequence,
+                             const char* data, long long dataOffset, long long dataSize);
+        FastaReference(const FastaReference&);
+        FastaReference& operator=(const FastaReference&);
 };
 
 #endif
@@ -223,24 +223,24 @@ bool Genotype::isHomozygousReference(void) {
 }
 
 // the probability of drawing each allele out of the genotype, ordered by allele
-vector<long double> Genotype::alleleProbabilities(void) {
-    vector<long double> probs;
+vector<ProbFloat> Genotype::alleleProbabilities(void) {
+    vector<ProbFloat> probs;
     for (vector<GenotypeElement>::const_iterator a = this->begin(); a != this->end(); ++a) {
-        probs.push_back((long double) a->count / (long double) ploidy);
+        probs.push_back((ProbFloat) a->count / (ProbFloat) ploidy);
     }
     return probs;
 }
 
 // the probability of drawing each allele out of the genotype, ordered by allele, adjusted for reference bias
-vector<long double> Genotype::alleleProbabilities(Bias& observationBias) {
-    vector<long double> probs;
+vector<ProbFloat> Genotype::alleleProbabilities(Bias& observationBias) {
+    vector<ProbFloat> probs;
     for (vector<GenotypeElement>::const_iterator a = this->begin(); a != this->end(); ++a) {
-	long double bias = 1;
+	ProbFloat bias = 1;
 	if (!a->allele.isReference()) {
 	    int alleleLengthDifference = a->allele.alternateSequence.size() - a->allele.referenceLength;
 	    bias = observationBias.bias(alleleLengthDifference);
 	}
-        probs.push_back(((long double) a->count / (long double) ploidy) * bias);
+        probs.push_back(((ProbFloat) a->count / (ProbFloat) ploidy) * bias);
     }
     normalizeSumToOne(probs);
     return probs;
@@ -346,6 +346,15 @@ vector<Genotype> allPossibleGenotypes(int ploidy, vector<Allele>& potentialAllel
     vector<vector<Allele> > alleleCombinations = multichoose(ploidy, potentialAlleles);
     for (vector<vector<Allele> >::iterator combo = alleleCombinations.begin(); combo != alleleCombinations.end(); ++combo) {
         genotypes.push_back(Genotype(*combo));
+        Genotype& genotype = genotypes.back();
+        for (Genotype::iterator e = genotype.begin(); e != genotype.end(); ++e) {
+            for (int i = 0; i < (int) potentialAlleles.size(); ++i) {
+                if (potentialAlleles[i].currentBase == e->allele.currentBase) {
+                    e->alleleIndex = i;
+                    break;
+                }
+            }
+        }
     }
     return genotypes;
 }
@@ -441,15 +450,15 @@ int GenotypeCombo::alleleCount(const string& allele) {
     }
 }
 
-long double GenotypeCombo::alleleFrequency(Allele& allele) {
-    return alleleCount(allele) / (long double) numberOfAlleles();
+ProbFloat GenotypeCombo::alleleFrequency(Allele& allele) {
+    return alleleCount(allele) / (ProbFloat) numberOfAlleles();
 }
 
-long double GenotypeCombo::alleleFrequency(const string& allele) {
-    return alleleCount(allele) / (long double) numberOfAlleles();
+ProbFloat GenotypeCombo::alleleFrequency(const string& allele) {
+    return alleleCount(allele) / (ProbFloat) numberOfAlleles();
 }
 
-long double GenotypeCombo::genotypeFrequency(Genotype* genotype) {
+ProbFloat GenotypeCombo::genotypeFrequency(Genotype* genotype) {
     map<Genotype*, int>::iterator g = genotypeCounts.find(genotype);
     if (g == genotypeCounts.end()) {
         return 0;
@@ -661,9 +670,9 @@ int GenotypeCombo::ploidy(void) {
     return copies;
 }
 
-vector<long double> GenotypeCombo::alleleProbs(void) {
-    vector<long double> probs;
-    long double copies = ploidy();
+vector<ProbFloat> GenotypeCombo::alleleProbs(void) {
+    vector<ProbFloat> probs;
+    ProbFloat copies = ploidy();
     for (map<string, AlleleCounter>::iterator a = alleleCounters.begin(); a != alleleCounters.end(); ++a) {
         const AlleleCounter& allele = a->second;
         probs.push_back(allele.frequency / copies);
@@ -767,14 +776,14 @@ void
 dataLikelihoodMaxGenotypeCombo(
     GenotypeCombo& combo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    ProbFloat diffusionPriorScalar) {
 
     for (SampleDataLikelihoods::iterator s = sampleDataLikelihoods.begin();
             s != sampleDataLikelihoods.end(); ++s) {
@@ -802,14 +811,14 @@ makeComboByDatalLikelihoodRank(
     SampleDataLikelihoods& variantSampleDataLikelihoods,
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     map<string, int>& priorACs,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    ProbFloat diffusionPriorScalar) {
 
     // generate the best genotype combination according to data
     // likelihoods
@@ -854,14 +863,14 @@ allLocalGenotypeCombinations(
     SampleDataLikelihoods& sampleDataLikelihoods,
     Samples& samples,
     map<string, int>& priorACs,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    ProbFloat diffusionPriorScalar,
     bool keepCombos) {
 
     // make the data likelihood maximum if needed
@@ -914,7 +923,7 @@ allLocalGenotypeCombinations(
             // replace genotype with new genotype
             combo.at(sampleOffset) = &*dl;
             // find data likelihood difference from ComboKing
-            long double diff = oldsdl.prob - newsdl.prob;
+            ProbFloat diff = oldsdl.prob - newsdl.prob;
             // adjust combination total data likelihood
             combo.probObsGivenGenotypes -= diff;
             combo.calculatePosteriorProbability(theta,
@@ -954,14 +963,14 @@ bandedGenotypeCombinations(
     Samples& samples,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    ProbFloat diffusionPriorScalar,
     bool keepCombos) {
 
     // get the number of samples that vary
@@ -1057,7 +1066,7 @@ bandedGenotypeCombinations(
                     // replace genotype with new genotype
                     oldsdl_ptr = newsdl;
                     // find data likelihood difference from ComboKing
-                    long double diff = oldsdl.prob - newsdl->prob;
+                    ProbFloat diff = oldsdl.prob - newsdl->prob;
                     // adjust combination total data likelihood
                     combo.probObsGivenGenotypes -= diff;
                 }
@@ -1099,14 +1108,14 @@ convergentGenotypeComboSearch(
     vector<Allele>& genotypeAlleles,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    ProbFloat diffusionPriorScalar,
     int maxiterations,
     int& totaliterations,
     bool addHomozygousCombos) {
@@ -1264,14 +1273,14 @@ void addAllHomozygousCombos(
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     Samples& samples,
     vector<Allele>& genotypeAlleles,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    ProbFloat diffusionPriorScalar) {
 
     // determine which homozygous combos we already have
 
@@ -1378,12 +1387,12 @@ void addAllHomozygousCombos(
 }
 
 // conditional probability of the genotype combination given the represented allele frequencies
-long double GenotypeCombo::probabilityGivenAlleleFrequencyln(bool permute) {
+ProbFloat GenotypeCombo::probabilityGivenAlleleFrequencyln(bool permute) {
 
     //return -multinomialCoefficientLn(numberOfAlleles(), counts());
 
     int n = numberOfAlleles();
-    long double lnhetscalar = 0;
+    ProbFloat lnhetscalar = 0;
 
     if (permute) {
         // scale by the product of permutations of heterozygotes
@@ -1394,8 +1403,8 @@ long double GenotypeCombo::probabilityGivenAlleleFrequencyln(bool permute) {
 
 }
 
-long double GenotypeCombo::hweComboProb(void) {
-    long double comboHweProb = 0;
+ProbFloat GenotypeCombo::hweComboProb(void) {
+    ProbFloat comboHweProb = 0;
     for (map<Genotype*, int>::iterator gc = genotypeCounts.begin(); gc != genotypeCounts.end(); ++gc) {
         Genotype* genotype = gc->first;
         comboHweProb += hweProbGenotypeFrequencyln(genotype);
@@ -1404,21 +1413,21 @@ long double GenotypeCombo::hweComboProb(void) {
 }
 
 // probability of the combo under HWE
-long double GenotypeCombo::hweExpectedFrequencyln(Genotype* genotype) {
+ProbFloat GenotypeCombo::hweExpectedFrequencyln(Genotype* genotype) {
 
     int ploidy = genotype->ploidy;
 
     vector<int> genotypeAlleleCounts;
-    vector<long double> alleleFrequencies;
+    vector<ProbFloat> alleleFrequencies;
     for (map<string, AlleleCounter>::iterator a = alleleCounters.begin(); a != alleleCounters.end(); ++a) {
         genotypeAlleleCounts.push_back(genotype->alleleCount(a->first));
-        alleleFrequencies.push_back((long double) a->second.frequency / (long double) numberOfAlleles());
+        alleleFrequencies.push_back((ProbFloat) a->second.frequency / (ProbFloat) numberOfAlleles());
     }
 
-    long double HWECoefficientln = multinomialCoefficientLn(ploidy, genotypeAlleleCounts);
+    ProbFloat HWECoefficientln = multinomialCoefficientLn(ploidy, genotypeAlleleCounts);
 
     vector<int>::iterator c = genotypeAlleleCounts.begin();
-    vector<long double>::iterator f = alleleFrequencies.begin();
+    vector<ProbFloat>::iterator f = alleleFrequencies.begin();
     for (; c != genotypeAlleleCounts.end(); ++c, ++f) {
          HWECoefficientln += powln(log(*f), *c);
     }
@@ -1429,7 +1438,7 @@ long double GenotypeCombo::hweExpectedFrequencyln(Genotype* genotype) {
 
 // probability that the genotype count in the combo is what it is given the
 // counts of the other alleles
-long double GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
+ProbFloat GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
 
     //cout << endl << *genotype << endl;
 
@@ -1461,10 +1470,10 @@ long double GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
         }
     }
 
-    long double arrangementsOfAllelesInSample = multinomialCoefficientLn(popTotalAlleles, popAlleleCounts);
+    ProbFloat arrangementsOfAllelesInSample = multinomialCoefficientLn(popTotalAlleles, popAlleleCounts);
     //cout << "arrangementsOfAllelesInSample = " << exp(arrangementsOfAllelesInSample) << endl;
 
-    long double arrangementsWithExactlyCountGenotypesGivenAF =
+    ProbFloat arrangementsWithExactlyCountGenotypesGivenAF =
         multinomialCoefficientLn(genotype->ploidy, thisGenotypeAlleleCounts)
         + multinomialCoefficientLn(popTotalGenotypes, popGenotypeCounts);
     /*
@@ -1487,14 +1496,14 @@ long double GenotypeCombo::hweProbGenotypeFrequencyln(Genotype* genotype) {
 //
 void
 GenotypeCombo::calculatePosteriorProbability(
-        long double theta,
+        ProbFloat theta,
         bool pooled,
         bool ewensPriors,
         bool permute,
         bool hwePriors,
         bool binomialObsPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalar) {
+        ProbFloat diffusionPriorScalar) {
 
     posteriorProb = 0;
     priorProb = 0;
@@ -1547,9 +1556,9 @@ GenotypeCombo::calculatePosteriorProbability(
             */
 
             priorProbObservations
-                += binomialProbln(alleleCounter.forwardStrand, obs, 0.5)
-                +  binomialProbln(alleleCounter.placedLeft, obs, 0.5)
-                +  binomialProbln(alleleCounter.placedStart, obs, 0.5);
+                += binomialHalfProbln(alleleCounter.forwardStrand, obs)
+                +  binomialHalfProbln(alleleCounter.placedLeft, obs)
+                +  binomialHalfProbln(alleleCounter.placedStart, obs);
         }
     }
 
@@ -1619,14 +1628,14 @@ void orderedGenotypeCombo(
     GenotypeCombo& combo,
     GenotypeCombo& orderedCombo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar) {
+    ProbFloat diffusionPriorScalar) {
 
     GenotypeComboMap bestComboMap;
 
@@ -1682,11 +1691,11 @@ int Genotype::containedAlleleTypes(void) {
 }
 
 
+// these use the sample's observations grouped by genotype allele
 vector<int> Genotype::alleleObservationCounts(Sample& sample) {
     vector<int> counts;
     for (Genotype::iterator i = begin(); i != end(); ++i) {
-        Allele& b = i->allele;
-        counts.push_back(sample.observationCount(b));
+        counts.push_back(sample.alleleObservationCount(i->alleleIndex));
     }
     return counts;
 }
@@ -1694,16 +1703,14 @@ vector<int> Genotype::alleleObservationCounts(Sample& sample) {
 int Genotype::alleleObservationCount(Sample& sample) {
     int count = 0;
     for (Genotype::iterator i = begin(); i != end(); ++i) {
-        Allele& b = i->allele;
-        count += sample.observationCount(b);
+        count += sample.alleleObservationCount(i->alleleIndex);
     }
     return count;
 }
 
 bool Genotype::sampleHasSupportingObservations(Sample& sample) {
     for (Genotype::iterator i = begin(); i != end(); ++i) {
-        Allele& b = i->allele;
-        if (sample.observationCount(b) != 0) {
+        if (sample.alleleObservationCount(i->alleleIndex) != 0) {
             return true;
         }
     }
@@ -34,7 +34,8 @@ class GenotypeElement {
 public:
     Allele allele;
     int count;
-    GenotypeElement(const Allele& a, int c) : allele(a), count(c) { }
+    int alleleIndex; // ordinal of the allele among the genotype alleles of the site
+    GenotypeElement(const Allele& a, int c) : allele(a), count(c), alleleIndex(-1) { }
 
 };
 
@@ -51,7 +52,7 @@ public:
     vector<Allele> alleles;
     map<string, int> alleleCounts;
     bool homozygous;
-    long double permutationsln;  // aka, multinomialCoefficientLn(ploidy, counts())
+    ProbFloat permutationsln;  // aka, multinomialCoefficientLn(ploidy, counts())
 
     Genotype(vector<Allele>& ungroupedAlleles) {
         alleles = ungroupedAlleles;
@@ -81,8 +82,8 @@ public:
     vector<string> alternateBases(string& refbase);
     vector<int> counts(void);
     // the probability of drawing each allele out of the genotype, ordered by allele
-    vector<long double> alleleProbabilities(void);
-    vector<long double> alleleProbabilities(Bias& observationBias);
+    vector<ProbFloat> alleleProbabilities(void);
+    vector<ProbFloat> alleleProbabilities(Bias& observationBias);
     double alleleSamplingProb(const string& base);
     double alleleSamplingProb(Allele& allele);
     string str(void) const;
@@ -108,18 +109,20 @@ public:
 string IUPAC(Genotype& g);
 string IUPAC2GenotypeStr(string iupac);
 
+// the elements of each genotype are indexed by the ordinal of their allele in
+// potentialAlleles
 vector<Genotype> allPossibleGenotypes(int ploidy, vector<Allele>& potentialAlleles);
 
 class SampleDataLikelihood {
 public:
     string name;
     Genotype* genotype;
-    long double prob;
-    long double marginal;
+    ProbFloat prob;
+    ProbFloat marginal;
     Sample* sample;
     bool hasObservations;
     int rank; // the rank of this data likelihood relative to others for the sample, 0 is best
-    SampleDataLikelihood(string n, Sample* s, Genotype* g, long double p, int r)
+    SampleDataLikelihood(string n, Sample* s, Genotype* g, ProbFloat p, int r)
         : name(n)
         , sample(s)
         , genotype(g)
@@ -167,9 +170,9 @@ public:
     // GenotypeCombo::prob is equal to the sum of probs in the combo.  We
     // factor it out so that we can construct the probabilities efficiently as
     // we generate the genotype combinations
-    long double probObsGivenGenotypes;  // aka data likelihood
+    ProbFloat probObsGivenGenotypes;  // aka data likelihood
 
-    long double permutationsln;  // the number of perutations of unphased genotypes in the combo
+    ProbFloat permutationsln;  // the number of perutations of unphased genotypes in the combo
 
     // these *must* be generated at construction time
     // for efficiency they can be updated as each genotype combo is generated
@@ -199,13 +202,13 @@ public:
     void appendIndependentCombo(GenotypeCombo& other);
 
     int numberOfAlleles(void);
-    vector<long double> alleleProbs(void);  // scales counts() by the total number of alleles
+    vector<ProbFloat> alleleProbs(void);  // scales counts() by the total number of alleles
     int ploidy(void); // the number of copies of the locus in this combination
     int alleleCount(Allele& allele);
     int alleleCount(const string& allele);
-    long double alleleFrequency(Allele& allele);
-    long double alleleFrequency(const string& allele);
-    long double genotypeFrequency(Genotype* genotype);
+    ProbFloat alleleFrequency(Allele& allele);
+    ProbFloat alleleFrequency(const string& allele);
+    ProbFloat genotypeFrequency(Genotype* genotype);
     void updateCachedCounts(Sample* sample, Genotype* oldGenotype, Genotype* newGenotype, bool useObsExpectations);
     map<string, int> countAlleles(void);
     map<int, int> countFrequencies(void);
@@ -219,32 +222,32 @@ public:
 
     // posterior
 
-    long double posteriorProb; // p(genotype combo) * p(observations | genotype combo)
+    ProbFloat posteriorProb; // p(genotype combo) * p(observations | genotype combo)
 
     // priors
 
-    long double priorProb; // p(genotype combo) = p(genotype combo | allele frequency) * p(allele frequency) * p(observations)
-    long double priorProbG_Af; // p(genotype combo | allele frequency)
-    long double priorProbAf; // p(allele frequency)
-    long double priorProbObservations; // p(observations)
-    long double priorProbGenotypesGivenHWE;
+    ProbFloat priorProb; // p(genotype combo) = p(genotype combo | allele frequency) * p(allele frequency) * p(observations)
+    ProbFloat priorProbG_Af; // p(genotype combo | allele frequency)
+    ProbFloat priorProbAf; // p(allele frequency)
+    ProbFloat priorProbObservations; // p(observations)
+    ProbFloat priorProbGenotypesGivenHWE;
 
     //GenotypeCombo* combo,
     void calculatePosteriorProbability(
-        long double theta,
+        ProbFloat theta,
         bool pooled,
         bool ewensPriors,
         bool permute,
         bool hwePriors,
         bool obsBinomialPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalarln);
+        ProbFloat diffusionPriorScalarln);
 
-    long double probabilityGivenAlleleFrequencyln(bool permute);
+    ProbFloat probabilityGivenAlleleFrequencyln(bool permute);
 
-    long double hweExpectedFrequencyln(Genotype* genotype);
-    long double hweProbGenotypeFrequencyln(Genotype* genotype);
-    long double hweComboProb(void);
+    ProbFloat hweExpectedFrequencyln(Genotype* genotype);
+    ProbFloat hweProbGenotypeFrequencyln(Genotype* genotype);
+    ProbFloat hweComboProb(void);
 
 };
 
@@ -322,14 +325,14 @@ orderedGenotypeCombo(
     GenotypeCombo& combo,
     GenotypeCombo& orderedCombo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    ProbFloat diffusionPriorScalar);
 
 void
 makeComboByDatalLikelihoodRank(
@@ -338,27 +341,27 @@ makeComboByDatalLikelihoodRank(
     SampleDataLikelihoods& variantSampleDataLikelihoods,
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     map<string, int>& priorACs,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    ProbFloat diffusionPriorScalar);
 
 void
 dataLikelihoodMaxGenotypeCombo(
     GenotypeCombo& combo,
     SampleDataLikelihoods& sampleDataLikelihoods,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    ProbFloat diffusionPriorScalar);
 
 bool
 bandedGenotypeCombinations(
@@ -369,14 +372,14 @@ bandedGenotypeCombinations(
     Samples& samples,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    ProbFloat diffusionPriorScalar);
 
 void
 allLocalGenotypeCombinations(
@@ -385,14 +388,14 @@ allLocalGenotypeCombinations(
     SampleDataLikelihoods& sampleDataLikelihoods,
     Samples& samples,
     map<string, int>& priorACs,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    ProbFloat diffusionPriorScalar,
     bool keepCombos);
 
 void
@@ -406,14 +409,14 @@ convergentGenotypeComboSearch(
     vector<Allele>& genotypeAlleles,
     map<string, int>& priorACs,
     int bandwidth, int banddepth,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar,
+    ProbFloat diffusionPriorScalar,
     int maxiterations,
     int& totaliterations,
     bool addHomozygousCombos);
@@ -426,14 +429,14 @@ addAllHomozygousCombos(
     SampleDataLikelihoods& invariantSampleDataLikelihoods,
     Samples& samples,
     vector<Allele>& genotypeAlleles,
-    long double theta,
+    ProbFloat theta,
     bool pooled,
     bool ewensPriors,
     bool permute,
     bool hwePriors,
     bool binomialObsPriors,
     bool alleleBalancePriors,
-    long double diffusionPriorScalar);
+    ProbFloat diffusionPriorScalar);
 
 
 vector<pair<Allele, int> > alternateAlleles(GenotypeCombo& combo, string referenceBase);
@@ -1,10 +1,10 @@
 #include "GenotypePriors.h"
 
 /*
-long double alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, long double theta) {
+ProbFloat alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, ProbFloat theta) {
 
     int M = 0;
-    long double p = 1;
+    ProbFloat p = 1;
 
     for (map<int, int>::const_iterator f = alleleFrequencyCounts.begin(); f != alleleFrequencyCounts.end(); ++f) {
         int frequency = f->first;
@@ -13,7 +13,7 @@ long double alleleFrequencyProbability(const map<int, int>& alleleFrequencyCount
         p *= (double) pow((double) theta, (double) count) / (double) pow((double) frequency, (double) count) * factorial(count);
     }
 
-    long double thetaH = 1;
+    ProbFloat thetaH = 1;
     for (int h = 1; h < M; ++h)
         thetaH *= theta + h;
 
@@ -21,19 +21,19 @@ long double alleleFrequencyProbability(const map<int, int>& alleleFrequencyCount
 
 }
 
-AlleleFrequencyProbabilityCache alleleFrequencyProbabilityCache;
+ThreadLocal<AlleleFrequencyProbabilityCache> alleleFrequencyProbabilityCache;
 
-long double alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta) {
-    return alleleFrequencyProbabilityCache.alleleFrequencyProbabilityln(alleleFrequencyCounts, theta);
+ProbFloat alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, ProbFloat theta) {
+    return alleleFrequencyProbabilityCache.get().alleleFrequencyProbabilityln(alleleFrequencyCounts, theta);
 }
 
 // Implements Ewens' Sampling Formula, which provides probability of a given
 // partition of alleles in a sample from a population
-long double __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta) {
+ProbFloat __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, ProbFloat theta) {
 
     int M = 0; // multiplicity of site
-    long double p = 0;
-    long double thetaln = log(theta);
+    ProbFloat p = 0;
+    ProbFloat thetaln = log(theta);
 
     for (map<int, int>::const_iterator f = alleleFrequencyCounts.begin(); f != alleleFrequencyCounts.end(); ++f) {
         int frequency = f->first;
@@ -42,7 +42,7 @@ long double __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyC
         p += powln(thetaln, count) - powln(log(frequency), count) + factorialln(count);
     }
 
-    long double thetaH = 0;
+    ProbFloat thetaH = 0;
     for (int h = 1; h < M; ++h)
         thetaH += log(theta + h);
 
@@ -52,10 +52,10 @@ long double __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyC
 */
 
 
-long double probabilityGenotypeComboGivenAlleleFrequencyln(GenotypeCombo& genotypeCombo, Allele& allele) {
+ProbFloat probabilityGenotypeComboGivenAlleleFrequencyln(GenotypeCombo& genotypeCombo, Allele& allele) {
 
     int n = genotypeCombo.numberOfAlleles();
-    long double lnhetscalar = 0;
+    ProbFloat lnhetscalar = 0;
 
     for (GenotypeCombo::iterator gc = genotypeCombo.begin(); gc != genotypeCombo.end(); ++gc) {
         SampleDataLikelihood& sgp = **gc;
@@ -75,21 +75,21 @@ GenotypeComboResult
 genotypeCombinationPriorProbability(
         GenotypeCombo* combo,
         Allele& refAllele,
-        long double theta,
+        ProbFloat theta,
         bool pooled,
         bool binomialObsPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalar) {
+        ProbFloat diffusionPriorScalar) {
 
         // when we are operating on pooled samples, we will not be able to
         // ascertain the number of heterozygotes in the pool,
         // rendering P(Genotype combo | Allele frequency) meaningless
-        long double priorProbabilityOfGenotypeComboG_Af = 0;
+        ProbFloat priorProbabilityOfGenotypeComboG_Af = 0;
         if (!pooled) {
             priorProbabilityOfGenotypeComboG_Af = probabilityGenotypeComboGivenAlleleFrequencyln(*combo, refAllele);
         }
 
-        long double priorObservationExpectationProb = 0;
+        ProbFloat priorObservationExpectationProb = 0;
 
         if (binomialObsPriors) {
             // for each alternate and the reference allele
@@ -143,11 +143,11 @@ genotypeCombinationPriorProbability(
         }
 
         // Ewens' Sampling Formula
-        long double priorProbabilityOfGenotypeComboAf = 
+        ProbFloat priorProbabilityOfGenotypeComboAf = 
             alleleFrequencyProbabilityln(combo->countFrequencies(), theta);
-        long double priorProbabilityOfGenotypeCombo = 
+        ProbFloat priorProbabilityOfGenotypeCombo = 
             priorProbabilityOfGenotypeComboG_Af + priorProbabilityOfGenotypeComboAf;
-        long double priorComboProb = priorProbabilityOfGenotypeCombo + combo->prob + priorObservationExpectationProb;
+        ProbFloat priorComboProb = priorProbabilityOfGenotypeCombo + combo->prob + priorObservationExpectationProb;
 
         return GenotypeComboResult(combo,
                     priorComboProb,
@@ -164,11 +164,11 @@ genotypeCombinationsPriorProbability(
         vector<GenotypeComboResult>& genotypeComboProbs,
         vector<GenotypeCombo>& bandedCombos,
         Allele& refAllele,
-        long double theta,
+        ProbFloat theta,
         bool pooled,
         bool binomialObsPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalar) {
+        ProbFloat diffusionPriorScalar) {
 
     for (vector<GenotypeCombo>::iterator c = bandedCombos.begin(); c != bandedCombos.end(); ++c) {
 
@@ -12,17 +12,17 @@ using namespace std;
 
 map<Allele, int> countAlleles(vector<Genotype*>& genotypeCombo);
 map<int, int> countFrequencies(vector<Genotype*>& genotypeCombo);
-long double alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, long double theta);
-long double alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta);
-long double __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, long double theta);
-long double probabilityGenotypeComboGivenAlleleFrequencyln(GenotypeCombo& genotypeCombo, Allele& allele);
+ProbFloat alleleFrequencyProbability(const map<int, int>& alleleFrequencyCounts, ProbFloat theta);
+ProbFloat alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, ProbFloat theta);
+ProbFloat __alleleFrequencyProbabilityln(const map<int, int>& alleleFrequencyCounts, ProbFloat theta);
+ProbFloat probabilityGenotypeComboGivenAlleleFrequencyln(GenotypeCombo& genotypeCombo, Allele& allele);
 
-class AlleleFrequencyProbabilityCache : public map<map<int, int>, long double> {
+class AlleleFrequencyProbabilityCache : public map<map<int, int>, ProbFloat> {
 public:
-    long double alleleFrequencyProbabilityln(const map<int, int>& counts, long double theta) {
-        map<map<int, int>, long double>::iterator p = find(counts);
+    ProbFloat alleleFrequencyProbabilityln(const map<int, int>& counts, ProbFloat theta) {
+        map<map<int, int>, ProbFloat>::iterator p = find(counts);
         if (p == end()) {
-            long double pln = __alleleFrequencyProbabilityln(counts, theta);
+            ProbFloat pln = __alleleFrequencyProbabilityln(counts, theta);
             insert(make_pair(counts, pln));
             return pln;
         } else {
@@ -35,20 +35,20 @@ GenotypeComboResult
 genotypeCombinationsPriorProbability(
         GenotypeCombo* combo,
         Allele& refAllele,
-        long double theta,
+        ProbFloat theta,
         bool pooled,
         bool obsBinomialPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalarln);
+        ProbFloat diffusionPriorScalarln);
 
 void genotypeCombinationsPriorProbability(
         vector<GenotypeComboResult>& genotypeComboProbs,
         vector<GenotypeCombo>& bandedCombos,
         Allele& refAllele,
-        long double theta,
+        ProbFloat theta,
         bool pooled,
         bool obsBinomialPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalarln);
+        ProbFloat diffusionPriorScalarln);
 
 #endif
@@ -0,0 +1,132 @@
+#include "LikelihoodKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIKELIHOOD_KERNEL_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// the bits of a double below its exponent, and the exponent of [0.5, 1)
+static const uint64_t MANTISSA_BITS = 0x000fffffffffffffULL;
+static const uint64_t HALF_EXPONENT = 0x3fe0000000000000ULL;
+static const int64_t EXPONENT_BIAS = 1022;
+
+static inline double observationProb(const double* probs, int alleleCount, int n,
+                                     const double* samplingProbs, int i) {
+    double probi = 0;
+    for (int j = 0; j < alleleCount; ++j) {
+        probi += samplingProbs[j] * probs[j * n + i];
+    }
+    return probi;
+}
+
+// bound to (0,1], leaving observations which can't be explained out of the product
+static inline double boundedProb(double probi) {
+    if (probi > 0) {
+        return min(max(probi, LIKELIHOOD_KERNEL_MIN_PROB), 1.0);
+    } else {
+        return 1;
+    }
+}
+
+// multiplies a lane's product by p, and moves the exponent of the result to
+// the lane's exponent, leaving the product in [0.5, 1)
+static inline void accumulate(double p, double& product, int64_t& exponent) {
+    double x = product * p;
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    exponent += (int64_t) (bits >> 52) - EXPONENT_BIAS;
+    bits = (bits & MANTISSA_BITS) | HALF_EXPONENT;
+    memcpy(&product, &bits, sizeof(bits));
+}
+
+static double sumLanes(const double* products, const int64_t* exponents) {
+    double sum = 0;
+    int64_t exponent = 0;
+    for (int k = 0; k < LIKELIHOOD_KERNEL_LANES; ++k) {
+        sum += log(products[k]);
+        exponent += exponents[k];
+    }
+    return sum + exponent * M_LN2;
+}
+
+// observation i goes to lane i % LIKELIHOOD_KERNEL_LANES, as in the AVX2 kernel
+static double sumLogObservationProbsScalar(const double* probs, int alleleCount, int n,
+                                           const double* samplingProbs) {
+    double products[LIKELIHOOD_KERNEL_LANES];
+    int64_t exponents[LIKELIHOOD_KERNEL_LANES];
+    for (int k = 0; k < LIKELIHOOD_KERNEL_LANES; ++k) {
+        products[k] = 1;
+        exponents[k] = 0;
+    }
+    for (int i = 0; i < n; ++i) {
+        accumulate(boundedProb(observationProb(probs, alleleCount, n, samplingProbs, i)),
+                   products[i % LIKELIHOOD_KERNEL_LANES], exponents[i % LIKELIHOOD_KERNEL_LANES]);
+    }
+    return sumLanes(products, exponents);
+}
+
+#ifdef LIKELIHOOD_KERNEL_AVX2
+__attribute__((target("avx2")))
+static double sumLogObservationProbsAVX2(const double* probs, int alleleCount, int n,
+                                         const double* samplingProbs) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1);
+    const __m256d minProb = _mm256_set1_pd(LIKELIHOOD_KERNEL_MIN_PROB);
+    const __m256i mantissaBits = _mm256_set1_epi64x(MANTISSA_BITS);
+    const __m256i halfExponent = _mm256_set1_epi64x(HALF_EXPONENT);
+    const __m256i exponentBias = _mm256_set1_epi64x(EXPONENT_BIAS);
+
+    __m256d product = one;
+    __m256i exponent = _mm256_setzero_si256();
+
+    int i = 0;
+    for ( ; i + LIKELIHOOD_KERNEL_LANES <= n; i += LIKELIHOOD_KERNEL_LANES) {
+        __m256d probi = zero;
+        for (int j = 0; j < alleleCount; ++j) {
+            probi = _mm256_add_pd(probi, _mm256_mul_pd(_mm256_set1_pd(samplingProbs[j]),
+                                                       _mm256_loadu_pd(probs + j * n + i)));
+        }
+        __m256d bounded = _mm256_min_pd(_mm256_max_pd(probi, minProb), one);
+        bounded = _mm256_blendv_pd(one, bounded, _mm256_cmp_pd(probi, zero, _CMP_GT_OQ));
+        __m256i bits = _mm256_castpd_si256(_mm256_mul_pd(product, bounded));
+        exponent = _mm256_add_epi64(exponent, _mm256_sub_epi64(_mm256_srli_epi64(bits, 52), exponentBias));
+        product = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissaBits), halfExponent));
+    }
+
+    double products[LIKELIHOOD_KERNEL_LANES];
+    int64_t exponents[LIKELIHOOD_KERNEL_LANES];
+    _mm256_storeu_pd(products, product);
+    _mm256_storeu_si256((__m256i*) exponents, exponent);
+    // the remaining observations, fewer than a register holds, start at lane 0
+    for (int k = 0; k < LIKELIHOOD_KERNEL_LANES && i + k < n; ++k) {
+        accumulate(boundedProb(observationProb(probs, alleleCount, n, samplingProbs, i + k)),
+                   products[k], exponents[k]);
+    }
+    return sumLanes(products, exponents);
+}
+#endif
+
+typedef double (*LikelihoodKernel)(const double*, int, int, const double*);
+
+static LikelihoodKernel chooseLikelihoodKernel(void) {
+#ifdef LIKELIHOOD_KERNEL_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return sumLogObservationProbsAVX2;
+    }
+#endif
+    return sumLogObservationProbsScalar;
+}
+
+// chosen once, as the program starts
+static LikelihoodKernel likelihoodKernel = chooseLikelihoodKernel();
+
+double sumLogObservationProbs(const double* probs, int alleleCount, int n, const double* samplingProbs) {
+    return likelihoodKernel(probs, alleleCount, n, samplingProbs);
+}
@@ -0,0 +1,29 @@
+#ifndef LIKELIHOODKERNEL_H
+#define LIKELIHOODKERNEL_H
+
+// the number of observations summed together, in the lanes of a vector
+// register where the CPU has them, or in as many scalar accumulators
+#define LIKELIHOOD_KERNEL_LANES 4
+
+// observation probabilities below this are raised to it, so that products of
+// them stay normal doubles; anything this unlikely is beyond what the quality
+// values of a read can express
+#define LIKELIHOOD_KERNEL_MIN_PROB 1e-300
+
+// the sum over n observations of the log of the probability of each, which is
+//
+//     sum over alleles j of samplingProbs[j] * probs[j * n + i]
+//
+// bounded to (0,1], with observations of probability 0 ignored
+//
+// probs holds, for each allele, the probability of each observation given
+// that it was sampled from the allele
+//
+// the logs are taken of products of the observation probabilities, with
+// their exponents carried separately, rather than of each one.  the AVX2
+// kernel is used where the CPU supports it, and otherwise a scalar one which
+// orders its arithmetic in the same way, so the result does not depend on
+// which is used
+double sumLogObservationProbs(const double* probs, int alleleCount, int n, const double* samplingProbs);
+
+#endif
@@ -6,7 +6,7 @@
 void marginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, Results& results) {
 
 
-    map<string, map<Genotype*, vector<long double> > > rawMarginals;
+    map<string, map<Genotype*, vector<ProbFloat> > > rawMarginals;
 
     // push the marginal likelihoods into the rawMarginals vectors in the results
     for (list<GenotypeCombo>::iterator gc = genotypeCombos.begin(); gc != genotypeCombos.end(); ++gc) {
@@ -19,14 +19,14 @@ void marginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, Results& r
     // safely add the raw marginal vectors using logsumexp
     for (Results::iterator r = results.begin(); r != results.end(); ++r) {
         ResultData& sample = r->second;
-        map<Genotype*, vector<long double> >& rawmgs = rawMarginals[r->first];
-        vector<long double> probs;
-        for (map<Genotype*, vector<long double> >::iterator m = rawmgs.begin(); m != rawmgs.end(); ++m) {
+        map<Genotype*, vector<ProbFloat> >& rawmgs = rawMarginals[r->first];
+        vector<ProbFloat> probs;
+        for (map<Genotype*, vector<ProbFloat> >::iterator m = rawmgs.begin(); m != rawmgs.end(); ++m) {
             probs.push_back(logsumexp_probs(m->second));
         }
-        long double normalizer = logsumexp_probs(probs);
-        vector<long double>::iterator p = probs.begin();
-        for (map<Genotype*, vector<long double> >::iterator m = rawmgs.begin(); m != rawmgs.end(); ++m, ++p) {
+        ProbFloat normalizer = logsumexp_probs(probs);
+        vector<ProbFloat>::iterator p = probs.begin();
+        for (map<Genotype*, vector<ProbFloat> >::iterator m = rawmgs.begin(); m != rawmgs.end(); ++m, ++p) {
             sample.marginals[m->first] = *p - normalizer;
         }
     }
@@ -38,25 +38,25 @@ void marginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, Results& r
 // assumes that the genotype combos are in the same order as the likelihoods
 // assumes that the genotype combos are the same size as the number of samples in the likelihoods
 // returns the delta from the previous marginals, informative in the case of EM
-long double marginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, SampleDataLikelihoods& likelihoods) {
+ProbFloat marginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, SampleDataLikelihoods& likelihoods) {
 
-    long double delta = 0;
+    ProbFloat delta = 0;
 
-    vector< map<Genotype*, long double> > rawMarginals;
+    vector< map<Genotype*, ProbFloat> > rawMarginals;
     rawMarginals.resize(likelihoods.size());
-    vector< map<Genotype*, long double> >::iterator rawMarginalsItr;
+    vector< map<Genotype*, ProbFloat> >::iterator rawMarginalsItr;
 
     // push the marginal likelihoods into the rawMarginals maps
     for (list<GenotypeCombo>::iterator gc = genotypeCombos.begin(); gc != genotypeCombos.end(); ++gc) {
         rawMarginalsItr = rawMarginals.begin();
         for (GenotypeCombo::const_iterator i = gc->begin(); i != gc->end(); ++i) {
             const SampleDataLikelihood& sdl = **i;
-            map<Genotype*, long double>& rmgs = *rawMarginalsItr++;
-            map<Genotype*, long double>::iterator rmgsItr = rmgs.find(sdl.genotype);
+            map<Genotype*, ProbFloat>& rmgs = *rawMarginalsItr++;
+            map<Genotype*, ProbFloat>::iterator rmgsItr = rmgs.find(sdl.genotype);
             if (rmgsItr == rmgs.end()) {
                 rmgs[sdl.genotype] = gc->posteriorProb;
             } else {
-                //vector<long double> x;
+                //vector<ProbFloat> x;
                 //x.push_back(rmgsItr->second); x.push_back(gc->posteriorProb);
                 //rmgs[sdl.genotype] = logsumexp_probs(x);
                 rmgs[sdl.genotype] = log(safe_exp(rmgsItr->second) + safe_exp(gc->posteriorProb));
@@ -67,20 +67,20 @@ long double marginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, Sam
     // safely add the raw marginal vectors using logsumexp
     // and use to update the sample data likelihoods
     rawMarginalsItr = rawMarginals.begin();
-    long double minAllowedMarginal = -1e-16;
+    ProbFloat minAllowedMarginal = -1e-16;
     for (SampleDataLikelihoods::iterator s = likelihoods.begin(); s != likelihoods.end(); ++s) {
         vector<SampleDataLikelihood>& sdls = *s;
-        const map<Genotype*, long double>& rawmgs = *rawMarginalsItr++;
-        map<Genotype*, long double> marginals;
-        vector<long double> rawprobs;
-        for (map<Genotype*, long double>::const_iterator m = rawmgs.begin(); m != rawmgs.end(); ++m) {
-            long double p = m->second;
+        const map<Genotype*, ProbFloat>& rawmgs = *rawMarginalsItr++;
+        map<Genotype*, ProbFloat> marginals;
+        vector<ProbFloat> rawprobs;
+        for (map<Genotype*, ProbFloat>::const_iterator m = rawmgs.begin(); m != rawmgs.end(); ++m) {
+            ProbFloat p = m->second;
             marginals[m->first] = p;
             rawprobs.push_back(p);
         }
-        long double normalizer = logsumexp_probs(rawprobs);
+        ProbFloat normalizer = logsumexp_probs(rawprobs);
         for (vector<SampleDataLikelihood>::iterator sdl = sdls.begin(); sdl != sdls.end(); ++sdl) {
-            long double newmarginal = marginals[sdl->genotype] - normalizer;
+            ProbFloat newmarginal = marginals[sdl->genotype] - normalizer;
             delta += newmarginal - sdl->marginal;
             // ensure the marginal is non-0 to guard against underflow
             sdl->marginal = min(minAllowedMarginal, newmarginal);
@@ -95,20 +95,20 @@ long double marginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, Sam
 void bestMarginalGenotypeCombo(GenotypeCombo& combo,
         Results& results,
         SampleDataLikelihoods& samples,
-        long double theta,
+        ProbFloat theta,
         bool pooled,
         bool permute,
         bool hwePriors,
         bool binomialObsPriors,
         bool alleleBalancePriors,
-        long double diffusionPriorScalar) {
+        ProbFloat diffusionPriorScalar) {
 
     for (SampleDataLikelihoods::iterator s = samples.begin(); s != samples.end(); ++s) {
         vector<SampleDataLikelihood>& sdls = *s;
         const string& name = sdls.front().name;
-        const map<Genotype*, long double>& marginals = results[name].marginals;;
-        map<Genotype*, long double>::const_iterator m = marginals.begin();
-        long double bestMarginalProb = m->second;
+        const map<Genotype*, ProbFloat>& marginals = results[name].marginals;;
+        map<Genotype*, ProbFloat>::const_iterator m = marginals.begin();
+        ProbFloat bestMarginalProb = m->second;
         Genotype* bestMarginalGenotype = m->first;
         ++m;
         for (; m != marginals.end(); ++m) {
@@ -132,14 +132,14 @@ void bestMarginalGenotypeCombo(GenotypeCombo& combo,
 }
 */
 
-long double balancedMarginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, SampleDataLikelihoods& likelihoods) {
+ProbFloat balancedMarginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCombos, SampleDataLikelihoods& likelihoods) {
 
-    long double delta = 0;
+    ProbFloat delta = 0;
 
-    //map<string, map<Genotype*, vector<long double> > > rawMarginals;
-    vector< map<Genotype*, vector<long double> > > rawMarginals;
+    //map<string, map<Genotype*, vector<ProbFloat> > > rawMarginals;
+    vector< map<Genotype*, vector<ProbFloat> > > rawMarginals;
     rawMarginals.resize(likelihoods.size());
-    vector< map<Genotype*, vector<long double> > >::iterator rawMarginalsItr;
+    vector< map<Genotype*, vector<ProbFloat> > >::iterator rawMarginalsItr;
 
     // push the marginal likelihoods into the rawMarginals maps
     for (list<GenotypeCombo>::iterator gc = genotypeCombos.begin(); gc != genotypeCombos.end(); ++gc) {
@@ -147,7 +147,7 @@ long double balancedMarginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCom
             rawMarginalsItr = rawMarginals.begin();
             for (GenotypeCombo::const_iterator i = gc->begin(); i != gc->end(); ++i) {
                 const SampleDataLikelihood& sdl = **i;
-                map<Genotype*, vector<long double> >& rmgs = *rawMarginalsItr++;
+                map<Genotype*, vector<ProbFloat> >& rmgs = *rawMarginalsItr++;
                 rmgs[sdl.genotype].push_back(gc->posteriorProb);
             }
         } else {
@@ -157,7 +157,7 @@ long double balancedMarginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCom
                 const SampleDataLikelihood& sdl = **i;
                 if (sdl.rank != 0) {
                     isComboKing = false;
-                    map<Genotype*, vector<long double> >& rmgs = *rawMarginalsItr;
+                    map<Genotype*, vector<ProbFloat> >& rmgs = *rawMarginalsItr;
                     rmgs[sdl.genotype].push_back(gc->posteriorProb);
                 }
                 ++rawMarginalsItr;
@@ -166,7 +166,7 @@ long double balancedMarginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCom
                 rawMarginalsItr = rawMarginals.begin();
                 for (GenotypeCombo::const_iterator i = gc->begin(); i != gc->end(); ++i) {
                     const SampleDataLikelihood& sdl = **i;
-                    map<Genotype*, vector<long double> >& rmgs = *rawMarginalsItr++;
+                    map<Genotype*, vector<ProbFloat> >& rmgs = *rawMarginalsItr++;
                     rmgs[sdl.genotype].push_back(gc->posteriorProb);
                 }
             }
@@ -177,17 +177,17 @@ long double balancedMarginalGenotypeLikelihoods(list<GenotypeCombo>& genotypeCom
     rawMarginalsItr = rawMarginals.begin();
     for (SampleDataLikelihoods::iterator s = likelihoods.begin(); s != likelihoods.end(); ++s) {
         vector<SampleDataLikelihood>& sdls = *s;
-        const map<Genotype*, vector<long double> >& rawmgs = *rawMarginalsItr++;
-        map<Genotype*, long double> marginals;
-        vector<long double> rawprobs;
-        for (map<Genotype*, vector<long double> >::const_iterator m = rawmgs.begin(); m != rawmgs.end(); ++m) {
-            long double p = logsumexp_probs(m->second);
+        const map<Genotype*, vector<ProbFloat> >& rawmgs = *rawMarginalsItr++;
+        map<Genotype*, ProbFloat> marginals;
+        vector<ProbFloat> rawprobs;
+        for (map<Genotype*, vector<ProbFloat> >::const_iterator m = rawmgs.begin(); m != rawmgs.end(); ++m) {
+            ProbFloat p = logsumexp_probs(m->second);
             marginals[m->first] = p;
             rawprobs.push_back(p);
         }
-        long double normalizer = logsumexp_probs(rawprobs);
+        ProbFloat normalizer = logsumexp_probs(rawprobs);
         for (vector<SampleDataLikelihood>::iterator sdl = sdls.begin(); sdl != sdls.end(); ++sdl) {
-            long double newmarginal = marginals[sdl->genotype] - normalizer;
+            ProbFloat newmarginal = marginals[sdl->genotype] - normalizer;
             delta += newmarginal - sdl->marginal;
             sdl->marginal = newmarginal;
         }
@@ -4,8 +4,8 @@
 #include "Utility.h"
 #include <vector>
 
-long double multinomialSamplingProb(const vector<long double>& probs, const vector<int>& obs);
-long double multinomialSamplingProbLn(const vector<long double>& probs, const vector<int>& obs);
-long double multinomialCoefficientLn(int n, const vector<int>& counts);
+ProbFloat multinomialSamplingProb(const vector<ProbFloat>& probs, const vector<int>& obs);
+ProbFloat multinomialSamplingProbLn(const vector<ProbFloat>& probs, const vector<int>& obs);
+ProbFloat multinomialCoefficientLn(int n, const vector<int>& counts);
 
 #endif
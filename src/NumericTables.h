@@ -0,0 +1,18 @@
+#ifndef NUMERICTABLES_H
+#define NUMERICTABLES_H
+
+// tables of values used throughout the probability calculations, built into
+// the program rather than computed and cached as it runs
+//
+// they are constant, so may be read from any thread without locking
+
+// the number of log factorials in the table, from log(0!)
+#define LOG_FACTORIAL_TABLE_SIZE 100000
+
+// log(n!), from the table, or from Stirling's series beyond it
+double factorialln(int n);
+
+// the log probability of k successes in n trials each of probability 0.5
+double binomialHalfProbln(int k, int n);
+
+#endif
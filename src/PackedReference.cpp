@@ -0,0 +1,81 @@
+#include "PackedReference.h"
+
+static const char packedBases[] = { 'A', 'C', 'G', 'T' };
+
+static int packedCode(char base) {
+    switch (base) {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    default: return -1;
+    }
+}
+
+static bool startsAfter(long int position, const BaseRun& run) {
+    return position < run.start;
+}
+
+void PackedSequence::pack(const string& sequence) {
+    length = sequence.size();
+    bases.assign((length + 3) / 4, 0);
+    runs.clear();
+    for (long int i = 0; i < length; ++i) {
+        char base = toupper(sequence[i]);
+        int code = packedCode(base);
+        if (code < 0) {
+            if (!runs.empty()
+                && runs.back().base == base
+                && runs.back().start + runs.back().length == i) {
+                ++runs.back().length;
+            } else {
+                runs.push_back(BaseRun(i, 1, base));
+            }
+        } else {
+            bases[i / 4] |= code << ((i % 4) * 2);
+        }
+    }
+}
+
+void PackedSequence::getSubSequence(long int start, long int len, string& sequence) const {
+    sequence.clear();
+    len = min(len, length - start);
+    if (start < 0 || len < 1) {
+        return;
+    }
+    sequence.resize(len);
+    for (long int i = 0; i < len; ++i) {
+        long int p = start + i;
+        sequence[i] = packedBases[(bases[p / 4] >> ((p % 4) * 2)) & 3];
+    }
+    // the first run which may overlap the subsequence is the last to start at
+    // or before it
+    long int end = start + len;
+    vector<BaseRun>::const_iterator r = upper_bound(runs.begin(), runs.end(), start, startsAfter);
+    if (r != runs.begin()) {
+        --r;
+    }
+    for ( ; r != runs.end() && r->start < end; ++r) {
+        long int from = max(r->start, start);
+        long int to = min(r->start + r->length, end);
+        for (long int p = from; p < to; ++p) {
+            sequence[p - start] = r->base;
+        }
+    }
+}
+
+void PackedReference::load(FastaReference& reference) {
+    vector<string>& names = reference.index->sequenceNames;
+    for (vector<string>::iterator n = names.begin(); n != names.end(); ++n) {
+        sequences[*n].pack(reference.getSequence(*n));
+    }
+}
+
+bool PackedReference::getSubSequence(const string& seqname, long int start, long int length, string& sequence) const {
+    map<string, PackedSequence>::const_iterator s = sequences.find(seqname);
+    if (s == sequences.end()) {
+        return false;
+    }
+    s->second.getSubSequence(start, length, sequence);
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef PACKEDREFERENCE_H
+#define PACKEDREFERENCE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "Fasta.h"
+
+using namespace std;
+
+// a run of bases other than A, C, G and T, such as a stretch of N
+class BaseRun {
+public:
+    long int start;
+    long int length;
+    char base;
+
+    BaseRun(long int s, long int l, char b)
+        : start(s)
+        , length(l)
+        , base(b)
+    { }
+};
+
+// one reference sequence, packed four bases to a byte
+// bases which can't be packed are recorded as runs, which are written over
+// the packed bases when sequence is read back
+class PackedSequence {
+public:
+    long int length;
+    vector<unsigned char> bases;
+    vector<BaseRun> runs; // ordered by start
+
+    PackedSequence(void) : length(0) { }
+
+    void pack(const string& sequence);
+    void getSubSequence(long int start, long int length, string& sequence) const;
+};
+
+// the whole reference, loaded once from the FASTA and held in memory in a
+// quarter of its size, so that it can be shared by every thread calling
+// variants without further reads from disk
+//
+// sequence is returned in upper case, which is how the parser uses it
+// once loaded it is only read, so it needs no locking
+class PackedReference {
+public:
+    void load(FastaReference& reference);
+    // as FastaReference::getSubSequence, returning false if the sequence is not held
+    bool getSubSequence(const string& seqname, long int start, long int length, string& sequence) const;
+
+private:
+    map<string, PackedSequence> sequences;
+};
+
+#endif
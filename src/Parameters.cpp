@@ -105,6 +105,8 @@ void Parameters::usage(char** argv) {
         << "   -f --fasta-reference FILE" << endl
         << "                   Use FILE as the reference sequence for analysis." << endl
         << "                   An index file (FILE.fai) will be created if none exists." << endl
+        << "                   FILE may be compressed with bgzip, in which case FILE.fai" << endl
+        << "                   must exist, and FILE.gzi is used to locate its blocks." << endl
         << "                   If neither --targets nor --region are specified, FreeBayes" << endl
         << "                   will analyze every position in this reference." << endl
         << "   -t --targets FILE" << endl
@@ -343,6 +345,40 @@ void Parameters::usage(char** argv) {
         << "                   Calculate the marginal probability of genotypes and report as GQ in" << endl
         << "                   each sample field in the VCF output." << endl
         << endl
+        << "parallelism:" << endl
+        << endl
+        << "   --threads N     Split targets (or, if none are given, the reference sequences" << endl
+        << "                   in the BAM header) into regions of similar data volume, as" << endl
+        << "                   estimated from the BAM indexes, and process them using N" << endl
+        << "                   threads, each with its own BAM readers.  If the indexes" << endl
+        << "                   can't be read, regions of up to 1Mbp are used instead." << endl
+        << "                   Output is written in target order, with duplicate records" << endl
+        << "                   from overlapping targets removed.  Can't be used with" << endl
+        << "                   --stdin or --trace.  default: 1" << endl
+        << "   --site-threads N" << endl
+        << "                   Use N threads at each site to calculate the data likelihoods" << endl
+        << "                   of samples, and search the genotypes of populations, in" << endl
+        << "                   parallel.  Output is unchanged.  default: 1" << endl
+        << "   --plan-regions N" << endl
+        << "                   Split targets (or the reference sequences in the BAM header)" << endl
+        << "                   into about N regions of similar data volume, as estimated" << endl
+        << "                   from the BAM indexes, print them in the form seq:start-end," << endl
+        << "                   as used by --region and freebayes-parallel, and exit." << endl
+        << "   --checkpoint FILE" << endl
+        << "                   Record progress in FILE every minute.  If FILE exists, resume" << endl
+        << "                   the run that saved it, keeping the output written before it" << endl
+        << "                   was saved.  FILE is removed once the run completes.  Requires" << endl
+        << "                   --vcf, and the same targets and options as the saved run." << endl
+        << "   --reference-in-memory" << endl
+        << "                   Load the whole reference once, packed at two bits per base," << endl
+        << "                   and share it between threads, rather than reading it from" << endl
+        << "                   the FASTA file as calling proceeds.  Needs about a quarter" << endl
+        << "                   of the size of the reference in memory." << endl
+        << "   --bgzip-output" << endl
+        << "                   Compress the file given by --vcf with BGZF, as bgzip does," << endl
+        << "                   using the --threads threads, and write a tabix index of it" << endl
+        << "                   to FILE.tbi.  Can't be used with --checkpoint." << endl
+        << endl
         << "debugging:" << endl
         << endl
         << "   -d --debug      Print debugging output." << endl
@@ -454,6 +490,12 @@ Parameters::Parameters(int argc, char** argv) {
     minAltQSum = 0;
     baseQualityCap = 0;
     probContamination = 10e-9;
+    threads = 1;
+    siteThreads = 1;
+    planRegions = 0;
+    checkpointFile = "";
+    referenceInMemory = false;
+    bgzipOutput = false;
     //minAltQSumTotal = 0;
     minCoverage = 0;
     debuglevel = 0;
@@ -543,6 +585,12 @@ Parameters::Parameters(int argc, char** argv) {
             {"prob-contamination", required_argument, 0, '_'},
             {"contamination-estimates", required_argument, 0, ','},
             {"report-monomorphic", no_argument, 0, '6'},
+            {"threads", required_argument, 0, '{'},
+            {"site-threads", required_argument, 0, '}'},
+            {"plan-regions", required_argument, 0, '+'},
+            {"checkpoint", required_argument, 0, '*'},
+            {"reference-in-memory", no_argument, 0, '~'},
+            {"bgzip-output", no_argument, 0, '.'},
             {"debug", no_argument, 0, 'd'},
             {0, 0, 0, 0}
 
@@ -551,7 +599,7 @@ Parameters::Parameters(int argc, char** argv) {
     while (true) {
 
         int option_index = 0;
-        c = getopt_long(argc, argv, "hcO4ZKjH[0diN5a)Ik=wl6#uVXJY:b:G:M:x:@:A:f:t:r:s:v:n:B:p:m:q:R:Q:U:$:e:T:P:D:^:S:W:F:C:&:L:8:z:1:3:E:7:2:9:%:(:_:,:",
+        c = getopt_long(argc, argv, "hcO4ZKjH[0diN5a)Ik=wl6#uVXJY:b:G:M:x:@:A:f:t:r:s:v:n:B:p:m:q:R:Q:U:$:e:T:P:D:^:S:W:F:C:&:L:8:z:1:3:E:7:2:9:%:(:_:,:{:}:+:*:~.",
                         long_options, &option_index);
 
         if (c == -1) // end of options
@@ -1015,6 +1063,45 @@ Parameters::Parameters(int argc, char** argv) {
             }
             break;
 
+            // --threads
+        case '{':
+            if (!convert(optarg, threads) || threads < 1) {
+                cerr << "could not parse threads" << endl;
+                exit(1);
+            }
+            break;
+
+            // --site-threads
+        case '}':
+            if (!convert(optarg, siteThreads) || siteThreads < 1) {
+                cerr << "could not parse site-threads" << endl;
+                exit(1);
+            }
+            break;
+
+            // --plan-regions
+        case '+':
+            if (!convert(optarg, planRegions) || planRegions < 1) {
+                cerr << "could not parse plan-regions" << endl;
+                exit(1);
+            }
+            break;
+
+            // --checkpoint
+        case '*':
+            checkpointFile = optarg;
+            break;
+
+            // --reference-in-memory
+        case '~':
+            referenceInMemory = true;
+            break;
+
+            // --bgzip-output
+        case '.':
+            bgzipOutput = true;
+            break;
+
             // -d --debug
         case 'd':
             ++debuglevel;
@@ -1086,4 +1173,46 @@ Parameters::Parameters(int argc, char** argv) {
         exit(1);
     }
 
+    if (threads > 1) {
+        if (useStdin) {
+            cerr << "--threads requires indexed BAM files, and can't be used with --stdin." << endl;
+            exit(1);
+        }
+        if (trace) {
+            cerr << "--trace can't be used with --threads." << endl;
+            exit(1);
+        }
+    }
+
+    if (!checkpointFile.empty()) {
+        if (outputFile.empty()) {
+            cerr << "--checkpoint requires an output file given with --vcf." << endl;
+            exit(1);
+        }
+        if (useStdin) {
+            cerr << "--checkpoint requires indexed BAM files, and can't be used with --stdin." << endl;
+            exit(1);
+        }
+        if (trace) {
+            cerr << "--trace can't be used with --checkpoint." << endl;
+            exit(1);
+        }
+    }
+
+    if (bgzipOutput) {
+        if (outputFile.empty()) {
+            cerr << "--bgzip-output requires an output file given with --vcf." << endl;
+            exit(1);
+        }
+        if (!checkpointFile.empty()) {
+            cerr << "--bgzip-output can't be used with --checkpoint." << endl;
+            exit(1);
+        }
+    }
+
+    if (planRegions > 0 && useStdin) {
+        cerr << "--plan-regions requires indexed BAM files, and can't be used with --stdin." << endl;
+        exit(1);
+    }
+
 }
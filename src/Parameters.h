@@ -48,6 +48,12 @@ public:
     int baseQualityCap;
     double probContamination;
     string contaminationEstimateFile;
+    int threads;                 // --threads
+    int siteThreads;             // --site-threads
+    int planRegions;             // --plan-regions
+    string checkpointFile;       // --checkpoint
+    bool referenceInMemory;      // --reference-in-memory
+    bool bgzipOutput;            // --bgzip-output
 
     // operation parameters
     bool outputAlleles;          //  unused...
@@ -102,14 +108,14 @@ public:
     int readSnpLimit;            // -$ --read-snp-limit
     int readIndelLimit;          // -e --read-indel-limit
     int IDW;                     // -I --indel-exclusion-window
-    long double TH;              // -T --theta
-    long double PVL;             // -P --pvar
+    ProbFloat TH;              // -T --theta
+    ProbFloat PVL;             // -P --pvar
                                  // -K --posterior-integration-depth
     int posteriorIntegrationDepth;
     bool calculateMarginals;
     string algorithm;
     double RDF;             // -D --read-dependence-factor
-    long double diffusionPriorScalar; // -V --diffusion-prior-scalar
+    ProbFloat diffusionPriorScalar; // -V --diffusion-prior-scalar
     int WB;                      // -W --posterior-integration-bandwidth
     // XXX adjusting this to anything other than 1 may have bad consequences
     // for large numbers of samples
@@ -117,7 +123,7 @@ public:
     bool includeMonoB;
     int TR;
     int I;
-    long double minAltFraction;  // -F --min-alternate-fraction
+    ProbFloat minAltFraction;  // -F --min-alternate-fraction
     int minAltCount;             // -C --min-alternate-count
     int minAltTotal;             // -G --min-alternate-total
     int minCoverage;             // -! --min-coverage
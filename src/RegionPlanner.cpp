@@ -0,0 +1,197 @@
+#include "RegionPlanner.h"
+
+RegionPlanner::RegionPlanner(vector<RefData>& refs)
+    : references(refs)
+{ }
+
+// places a BGZF virtual offset on an approximately compressed scale, so that
+// offsets within the same block remain distinct
+static long double compressedPosition(uint64_t offset) {
+    return (long double) (offset >> 16) + (long double) (offset & 0xffff) / BGZF_COMPRESSION_RATIO;
+}
+
+template <class T>
+static bool readValue(ifstream& in, T& value) {
+    in.read((char*) &value, sizeof(T));
+    return in.good();
+}
+
+bool RegionPlanner::addIndex(const string& bamFile) {
+
+    // bamtools and samtools name indexes file.bam.bai, but file.bai is also common
+    ifstream in((bamFile + ".bai").c_str(), ios::in | ios::binary);
+    if (!in.is_open() && bamFile.size() > 4
+        && bamFile.substr(bamFile.size() - 4) == ".bam") {
+        in.open((bamFile.substr(0, bamFile.size() - 4) + ".bai").c_str(), ios::in | ios::binary);
+    }
+    if (!in.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    in.read(magic, 4);
+    if (!in.good() || magic[0] != 'B' || magic[1] != 'A' || magic[2] != 'I' || magic[3] != 1) {
+        return false;
+    }
+
+    int32_t referenceCount;
+    if (!readValue(in, referenceCount)) {
+        return false;
+    }
+
+    for (int32_t r = 0; r < referenceCount; ++r) {
+
+        // the offset after the last alignment on the reference is the
+        // greatest chunk end in its bins
+        uint64_t end = 0;
+        int32_t binCount;
+        if (!readValue(in, binCount)) return false;
+        for (int32_t b = 0; b < binCount; ++b) {
+            uint32_t bin;
+            int32_t chunkCount;
+            if (!readValue(in, bin) || !readValue(in, chunkCount)) return false;
+            for (int32_t c = 0; c < chunkCount; ++c) {
+                uint64_t chunkBegin, chunkEnd;
+                if (!readValue(in, chunkBegin) || !readValue(in, chunkEnd)) return false;
+                if (bin != BAM_INDEX_PSEUDO_BIN) {
+                    end = max(end, chunkEnd);
+                }
+            }
+        }
+
+        int32_t windowCount;
+        if (!readValue(in, windowCount)) return false;
+        vector<uint64_t> offsets(windowCount);
+        for (int32_t w = 0; w < windowCount; ++w) {
+            if (!readValue(in, offsets[w])) return false;
+        }
+
+        if (r >= (int32_t) references.size()) {
+            continue;
+        }
+
+        // windows without alignments may be recorded as 0
+        for (int32_t w = 1; w < windowCount; ++w) {
+            offsets[w] = max(offsets[w], offsets[w - 1]);
+        }
+        offsets.push_back(max(end, offsets.empty() ? 0 : offsets.back()));
+
+        vector<long double>& costs = windowCosts[references.at(r).RefName];
+        if (costs.size() < (size_t) windowCount) {
+            costs.resize(windowCount, 0);
+        }
+        for (int32_t w = 0; w < windowCount; ++w) {
+            costs[w] += compressedPosition(offsets[w + 1]) - compressedPosition(offsets[w]);
+        }
+
+    }
+
+    return true;
+
+}
+
+// the estimated cost of each window overlapping the target, in proportion to
+// the part of the window inside it
+void RegionPlanner::targetWindowCosts(BedTarget& target, vector<long double>& costs) {
+
+    costs.clear();
+    if (target.right <= target.left) {
+        return;
+    }
+
+    int first = target.left / BAM_LINEAR_INDEX_WINDOW;
+    int last = (target.right - 1) / BAM_LINEAR_INDEX_WINDOW;
+
+    map<string, vector<long double> >::iterator s = windowCosts.find(target.seq);
+    for (int w = first; w <= last; ++w) {
+        long double cost = 0;
+        if (s != windowCosts.end() && w < (int) s->second.size()) {
+            long int left = max((long int) target.left, (long int) w * BAM_LINEAR_INDEX_WINDOW);
+            long int right = min((long int) target.right, (long int) (w + 1) * BAM_LINEAR_INDEX_WINDOW);
+            cost = s->second.at(w) * (right - left) / BAM_LINEAR_INDEX_WINDOW;
+        }
+        costs.push_back(cost);
+    }
+
+}
+
+bool RegionPlanner::plan(vector<BedTarget>& targets, int count, vector<BedTarget>& regions) {
+
+    vector<vector<long double> > targetCosts(targets.size());
+    long double total = 0;
+    for (size_t t = 0; t < targets.size(); ++t) {
+        targetWindowCosts(targets.at(t), targetCosts.at(t));
+        for (vector<long double>::iterator c = targetCosts.at(t).begin(); c != targetCosts.at(t).end(); ++c) {
+            total += *c;
+        }
+    }
+
+    if (total <= 0) {
+        return false;
+    }
+
+    long double regionCost = total / max(count, 1);
+
+    for (size_t t = 0; t < targets.size(); ++t) {
+
+        BedTarget& target = targets.at(t);
+        vector<long double>& costs = targetCosts.at(t);
+        int n = costs.size();
+
+        if (n == 0) {
+            regions.push_back(target);
+            continue;
+        }
+
+        vector<long double> cumulative(n + 1, 0);
+        for (int w = 0; w < n; ++w) {
+            cumulative[w + 1] = cumulative[w] + costs[w];
+        }
+
+        int first = target.left / BAM_LINEAR_INDEX_WINDOW;
+        int left = target.left;
+        int start = 0;
+
+        while (start < n) {
+
+            // the window boundary at which the region reaches its share
+            int even = start + 1;
+            while (even < n && cumulative[even] - cumulative[start] < regionCost) {
+                ++even;
+            }
+
+            // move the split to the nearby boundary with the least data to
+            // either side of it, or to the end of the target if it is close,
+            // provided the region stays close to its share
+            int split = even;
+            if (even < n) {
+                long double quietest = costs[even - 1] + costs[even];
+                int from = max(start + 1, even - REGION_SPLIT_SEARCH_WINDOWS);
+                int to = min(n, even + REGION_SPLIT_SEARCH_WINDOWS);
+                for (int b = from; b <= to; ++b) {
+                    long double cost = cumulative[b] - cumulative[start];
+                    if (cost < regionCost * (1 - REGION_SPLIT_COST_TOLERANCE)
+                        || cost > regionCost * (1 + REGION_SPLIT_COST_TOLERANCE)) {
+                        continue;
+                    }
+                    long double activity = (b == n) ? 0 : costs[b - 1] + costs[b];
+                    if (activity < quietest
+                        || (activity == quietest && abs(b - even) < abs(split - even))) {
+                        quietest = activity;
+                        split = b;
+                    }
+                }
+            }
+
+            int right = (split == n) ? target.right : (first + split) * BAM_LINEAR_INDEX_WINDOW;
+            regions.push_back(BedTarget(target.seq, left, right, target.desc));
+            left = right;
+            start = split;
+
+        }
+
+    }
+
+    return true;
+
+}
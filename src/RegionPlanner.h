@@ -0,0 +1,69 @@
+#ifndef REGIONPLANNER_H
+#define REGIONPLANNER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdint.h>
+#include "api/BamAux.h"
+#include "BedReader.h"
+
+using namespace std;
+using namespace BamTools;
+
+// the width of the windows of the BAM linear index
+#define BAM_LINEAR_INDEX_WINDOW 16384
+
+// the pseudo-bin in which samtools records mapped and unmapped read counts
+#define BAM_INDEX_PSEUDO_BIN 37450
+
+// the approximate ratio of decompressed to compressed bytes in BAM files,
+// used to place offsets within a BGZF block on the compressed scale
+#define BGZF_COMPRESSION_RATIO 3
+
+// the number of index windows to either side of an even split in which to
+// look for a quieter place to split, and the fraction by which moving the
+// split may change the data volume of the region
+#define REGION_SPLIT_SEARCH_WINDOWS 8
+#define REGION_SPLIT_COST_TOLERANCE 0.25
+
+// the number of planned regions per thread, so that threads which finish
+// their regions early can take on others
+#define PLANNED_REGIONS_PER_THREAD 16
+
+// splits targets into regions of roughly equal data volume, estimated from
+// the linear index of each BAM file without reading any alignments
+//
+// for each 16kbp window, the linear index gives the offset of the first
+// alignment overlapping it, so the distance to the next window's offset
+// approximates the compressed size of the window's alignments
+class RegionPlanner {
+
+public:
+
+    RegionPlanner(vector<RefData>& references);
+
+    // adds the data volume recorded in the index of the given BAM file
+    // returns false if the file has no readable index
+    bool addIndex(const string& bamFile);
+
+    // splits the targets into around count regions of similar data volume
+    // each split is placed at the quietest window boundary near an even split,
+    // so that haplotype windows are rarely cut in covered regions
+    // returns false if the indexes record no data in the targets
+    bool plan(vector<BedTarget>& targets, int count, vector<BedTarget>& regions);
+
+private:
+
+    vector<RefData>& references;
+    map<string, vector<long double> > windowCosts; // estimated bytes, by sequence and window
+
+    void targetWindowCosts(BedTarget& target, vector<long double>& costs);
+
+};
+
+#endif
@@ -7,9 +7,9 @@ using namespace std;
 
 vcf::Variant& Results::vcf(
     vcf::Variant& var, // variant to update
-    BigFloat pHom,
-    long double bestComboOddsRatio,
-    //long double alleleSamplingProb,
+    ProbFloat pHomln,
+    ProbFloat bestComboOddsRatio,
+    //ProbFloat alleleSamplingProb,
     Samples& samples,
     string refbase,
     vector<Allele>& altAllelesIncludingNulls,
@@ -63,7 +63,7 @@ vcf::Variant& Results::vcf(
     var.filter = ".";
 
     // note that we set QUAL to 0 at loci with no data
-    var.quality = max((long double) 0, nan2zero(big2phred(pHom)));
+    var.quality = max((ProbFloat) 0, lnprob2phred(pHomln));
     if (coverage == 0) {
         var.quality = 0;
     }
@@ -90,10 +90,10 @@ vcf::Variant& Results::vcf(
     unsigned int refEndRight = 0;
     unsigned int refmqsum = 0;
     unsigned int refProperPairs = 0;
-    long double refReadMismatchSum = 0;
-    long double refReadSNPSum = 0;
-    long double refReadIndelSum = 0;
-    long double refReadSoftClipSum = 0;
+    ProbFloat refReadMismatchSum = 0;
+    ProbFloat refReadSNPSum = 0;
+    ProbFloat refReadIndelSum = 0;
+    ProbFloat refReadSoftClipSum = 0;
     unsigned int refObsCount = 0;
     map<string, int> refObsBySequencingTechnology;
 
@@ -109,8 +109,8 @@ vcf::Variant& Results::vcf(
             if (allele.isProperPair) {
                 ++refProperPairs;
             }
-            if (!allele.sequencingTechnology.empty()) {
-                ++refObsBySequencingTechnology[allele.sequencingTechnology];
+            if (!allele.sequencingTechnology->empty()) {
+                ++refObsBySequencingTechnology[*allele.sequencingTechnology];
             }
             refBasesLeft += allele.basesLeft;
             refBasesRight += allele.basesRight;
@@ -133,9 +133,9 @@ vcf::Variant& Results::vcf(
         }
     }
 
-    long double refReadMismatchRate = (refObsCount == 0 ? 0 : refReadMismatchSum / (long double) refObsCount);
-    long double refReadSNPRate = (refObsCount == 0 ? 0 : refReadSNPSum / (long double) refObsCount);
-    long double refReadIndelRate = (refObsCount == 0 ? 0 : refReadIndelSum / (long double) refObsCount);
+    ProbFloat refReadMismatchRate = (refObsCount == 0 ? 0 : refReadMismatchSum / (ProbFloat) refObsCount);
+    ProbFloat refReadSNPRate = (refObsCount == 0 ? 0 : refReadSNPSum / (ProbFloat) refObsCount);
+    ProbFloat refReadIndelRate = (refObsCount == 0 ? 0 : refReadIndelSum / (ProbFloat) refObsCount);
 
     //var.info["XRM"].push_back(convert(refReadMismatchRate));
     //var.info["XRS"].push_back(convert(refReadSNPRate));
@@ -248,9 +248,9 @@ vcf::Variant& Results::vcf(
         unsigned int altEndRight = 0;
         unsigned int altmqsum = 0;
         unsigned int altproperPairs = 0;
-        long double altReadMismatchSum = 0;
-        long double altReadSNPSum = 0;
-        long double altReadIndelSum = 0;
+        ProbFloat altReadMismatchSum = 0;
+        ProbFloat altReadSNPSum = 0;
+        ProbFloat altReadIndelSum = 0;
         unsigned int altObsCount = 0;
         map<string, int> altObsBySequencingTechnology;
 
@@ -269,8 +269,8 @@ vcf::Variant& Results::vcf(
                 if (allele.isProperPair) {
                     ++altproperPairs;
                 }
-                if (!allele.sequencingTechnology.empty()) {
-                    ++altObsBySequencingTechnology[allele.sequencingTechnology];
+                if (!allele.sequencingTechnology->empty()) {
+                    ++altObsBySequencingTechnology[*allele.sequencingTechnology];
                 }
                 altBasesLeft += allele.basesLeft;
                 altBasesRight += allele.basesRight;
@@ -293,9 +293,9 @@ vcf::Variant& Results::vcf(
             }
         }
 
-        long double altReadMismatchRate = (altObsCount == 0 ? 0 : altReadMismatchSum / altObsCount);
-        long double altReadSNPRate = (altObsCount == 0 ? 0 : altReadSNPSum / altObsCount);
-        long double altReadIndelRate = (altObsCount == 0 ? 0 : altReadIndelSum / altObsCount);
+        ProbFloat altReadMismatchRate = (altObsCount == 0 ? 0 : altReadMismatchSum / altObsCount);
+        ProbFloat altReadSNPRate = (altObsCount == 0 ? 0 : altReadSNPSum / altObsCount);
+        ProbFloat altReadIndelRate = (altObsCount == 0 ? 0 : altReadIndelSum / altObsCount);
         
         //var.info["XAM"].push_back(convert(altReadMismatchRate));
         //var.info["XAS"].push_back(convert(altReadSNPRate));
@@ -510,7 +510,11 @@ vcf::Variant& Results::vcf(
             sampleOutput["GT"].push_back(genotype->relativeGenotype(refbase, altAlleles));
 
             if (parameters.calculateMarginals) {
+#ifdef BIGFLOAT_POSTERIORS
                 sampleOutput["GQ"].push_back(convert(nan2zero(big2phred((BigFloat)1 - big_exp(sampleLikelihoods.front().marginal)))));
+#else
+                sampleOutput["GQ"].push_back(convert(lnprob2phred(log1mexp(sampleLikelihoods.front().marginal))));
+#endif
             }
 
             sampleOutput["DP"].push_back(convert(sample.observationCount()));
@@ -595,11 +599,11 @@ vcf::Variant& Results::vcf(
                     }
 
                     // normalize GLs to -10 min 0 max using division by max and bounding at -10
-                    long double minGL = 0;
+                    ProbFloat minGL = 0;
                     for (map<int, double>::iterator g = genotypeLikelihoods.begin(); g != genotypeLikelihoods.end(); ++g) {
                         if (g->second < minGL) minGL = g->second;
                     }
-                    long double maxGL = minGL;
+                    ProbFloat maxGL = minGL;
                     for (map<int, double>::iterator g = genotypeLikelihoods.begin(); g != genotypeLikelihoods.end(); ++g) {
                         if (g->second > maxGL) maxGL = g->second;
                     }
@@ -610,7 +614,7 @@ vcf::Variant& Results::vcf(
                         }
                     } else {
                         for (map<int, double>::iterator g = genotypeLikelihoods.begin(); g != genotypeLikelihoods.end(); ++g) {
-                            genotypeLikelihoodsOutput[g->first] = convert( max((long double) + parameters.limitGL, (g->second-maxGL)) );
+                            genotypeLikelihoodsOutput[g->first] = convert( max((ProbFloat) + parameters.limitGL, (g->second-maxGL)) );
                         }
                     }
 
@@ -17,8 +17,8 @@ using namespace std;
 // for sorting data likelihoods
 class DataLikelihoodCompare {
 public:
-    bool operator()(const pair<Genotype*, long double>& a,
-            const pair<Genotype*, long double>& b) {
+    bool operator()(const pair<Genotype*, ProbFloat>& a,
+            const pair<Genotype*, ProbFloat>& b) {
         return a.second > b.second;
     }
 };
@@ -42,9 +42,9 @@ public:
 
     vcf::Variant& vcf(
         vcf::Variant& var, // variant to update
-        BigFloat pHom,
-        long double bestComboOddsRatio,
-        //long double alleleSamplingProb,
+        ProbFloat pHomln,  // log probability that the site is homozygous reference
+        ProbFloat bestComboOddsRatio,
+        //ProbFloat alleleSamplingProb,
         Samples& samples,
         string refbase,
         vector<Allele>& altAlleles,
@@ -50,7 +50,7 @@ double Sample::observationCountInclPartials(const string& base) {
 
 // the total number of observations
 int Sample::observationCount(void) {
-    int count = 0;
+    int count = referenceObservations.size();
     for (Sample::iterator g = begin(); g != end(); ++g) {
         count += g->second.size();
     }
@@ -89,6 +89,142 @@ double Sample::partialQualSum(const string& base) {
     return qsum;
 }
 
+int Sample::alleleObservationCount(int ordinal) {
+    if (ordinal < 0 || ordinal >= (int) alleleObservations.size()) {
+        return 0;
+    } else {
+        return alleleObservations[ordinal].size();
+    }
+}
+
+void Samples::setNames(const vector<string>& names) {
+    clear();
+    samples.clear();
+    samples.resize(names.size());
+    for (int i = 0; i < (int) names.size(); ++i) {
+        samples[i].name = names[i];
+        samples[i].index = i;
+    }
+}
+
+void Samples::beginSite(void) {
+    for (Samples::iterator s = begin(); s != end(); ++s) {
+        (*s)->clearFullObservations();
+        (*s)->observed = false;
+    }
+    lastObserved.swap(observedSamples);
+    observedSamples.clear();
+}
+
+Sample& Samples::observe(int index) {
+    Sample& sample = samples[index];
+    if (!sample.observed) {
+        sample.observed = true;
+        observedSamples.push_back(&sample);
+    }
+    return sample;
+}
+
+static bool sampleIndexLess(const Sample* a, const Sample* b) {
+    return a->index < b->index;
+}
+
+void Samples::endSite(void) {
+    for (Samples::iterator s = lastObserved.begin(); s != lastObserved.end(); ++s) {
+        if (!(*s)->observed) {
+            (*s)->clearObservations();
+        }
+    }
+    lastObserved.clear();
+    sort(observedSamples.begin(), observedSamples.end(), sampleIndexLess);
+}
+
+void Samples::addReferenceObservations(void) {
+    for (Samples::iterator s = begin(); s != end(); ++s) {
+        Sample& sample = **s;
+        if (sample.referenceObservations.empty()) {
+            continue;
+        }
+        for (vector<Allele*>::iterator a = sample.referenceObservations.begin();
+             a != sample.referenceObservations.end(); ++a) {
+            (*a)->updateReferenceBase();
+        }
+        vector<Allele*>& group = sample[sample.referenceObservations.front()->currentBase];
+        group.insert(group.end(), sample.referenceObservations.begin(), sample.referenceObservations.end());
+        sample.referenceObservations.clear();
+    }
+}
+
+Samples::iterator Samples::erase(Samples::iterator s) {
+    (*s)->clearObservations();
+    (*s)->observed = false;
+    return observedSamples.erase(s);
+}
+
+void Samples::clear(void) {
+    for (Samples::iterator s = begin(); s != end(); ++s) {
+        (*s)->clearObservations();
+        (*s)->observed = false;
+    }
+    for (Samples::iterator s = lastObserved.begin(); s != lastObserved.end(); ++s) {
+        (*s)->clearObservations();
+    }
+    observedSamples.clear();
+    lastObserved.clear();
+}
+
+// the ordinals are found once per allele group or partial observation, rather
+// than once per observation
+void Samples::groupByGenotypeAlleles(vector<Allele>& genotypeAlleles) {
+
+    map<string, int> ordinals;
+    for (int i = 0; i < (int) genotypeAlleles.size(); ++i) {
+        ordinals[genotypeAlleles[i].currentBase] = i;
+    }
+
+    for (Samples::iterator s = begin(); s != end(); ++s) {
+        Sample& sample = **s;
+
+        sample.alleleObservations.assign(genotypeAlleles.size(), vector<Allele*>());
+        sample.otherObservations.clear();
+        for (Sample::iterator g = sample.begin(); g != sample.end(); ++g) {
+            map<string, int>::iterator o = ordinals.find(g->first);
+            vector<Allele*>& group = (o == ordinals.end()) ? sample.otherObservations : sample.alleleObservations[o->second];
+            group.insert(group.end(), g->second.begin(), g->second.end());
+        }
+
+        // each partial observation supports the genotype allele of its own
+        // base, if any, and those it was assigned to
+        sample.partialObservations.clear();
+        map<Allele*, int> partialIndexes;
+        for (map<Allele*, set<Allele*> >::iterator r = sample.reversePartials.begin(); r != sample.reversePartials.end(); ++r) {
+            partialIndexes[r->first] = sample.partialObservations.size();
+            sample.partialObservations.push_back(PartialObservation(r->first, r->second.size()));
+            map<string, int>::iterator o = ordinals.find(r->first->currentBase);
+            if (o != ordinals.end()) {
+                sample.partialObservations.back().supported.push_back(o->second);
+            }
+        }
+        for (map<string, vector<Allele*> >::iterator p = sample.partialSupport.begin(); p != sample.partialSupport.end(); ++p) {
+            map<string, int>::iterator o = ordinals.find(p->first);
+            if (o == ordinals.end()) {
+                continue;
+            }
+            for (vector<Allele*>::iterator a = p->second.begin(); a != p->second.end(); ++a) {
+                map<Allele*, int>::iterator i = partialIndexes.find(*a);
+                if (i == partialIndexes.end()) {
+                    continue;
+                }
+                vector<int>& supported = sample.partialObservations[i->second].supported;
+                if (find(supported.begin(), supported.end(), o->second) == supported.end()) {
+                    supported.push_back(o->second);
+                }
+            }
+        }
+    }
+
+}
+
 // sample tracking and allele sorting
 // the number of observations for this allele
 int Samples::observationCount(Allele& allele) {
@@ -107,7 +243,7 @@ double Samples::partialObservationCount(Allele& allele) {
 int Samples::observationCount(const string& base) {
     int c = 0;
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        c += s->second.observationCount(base);
+        c += (*s)->observationCount(base);
     }
     return c;
 }
@@ -115,7 +251,7 @@ int Samples::observationCount(const string& base) {
 double Samples::partialObservationCount(const string& base) {
     double c = 0;
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        c += s->second.partialObservationCount(base);
+        c += (*s)->partialObservationCount(base);
     }
     return c;
 }
@@ -128,7 +264,7 @@ double Samples::observationCountInclPartials(const string& base) {
 int Samples::observationCount(void) {
     int c = 0;
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        c += s->second.observationCount();
+        c += (*s)->observationCount();
     }
     return c;
 }
@@ -136,7 +272,7 @@ int Samples::observationCount(void) {
 double Samples::observationCountInclPartials(void) {
     double c = 0;
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        c += s->second.observationCountInclPartials();
+        c += (*s)->observationCountInclPartials();
     }
     return c;
 }
@@ -148,7 +284,7 @@ int Samples::qualSum(Allele& allele) {
 int Samples::qualSum(const string& base) {
     int q = 0;
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        q += s->second.qualSum(base);
+        q += (*s)->qualSum(base);
     }
     return q;
 }
@@ -160,28 +296,32 @@ double Samples::partialQualSum(Allele& allele) {
 double Samples::partialQualSum(const string& base) {
     double q = 0;
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        q += s->second.partialQualSum(base);
+        q += (*s)->partialQualSum(base);
     }
     return q;
 }
 
-map<string, double> Samples::estimatedAlleleFrequencies(void) {
-    map<string, long double> qualsums;
+// observations of alleles other than the genotype alleles count towards the
+// total, as they would if grouped by base
+vector<double> Samples::estimatedAlleleFrequencies(int alleleCount) {
+    vector<ProbFloat> qualsums(alleleCount, 0);
+    ProbFloat total = 0;
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        Sample& sample = s->second;
-        for (Sample::iterator o = sample.begin(); o != sample.end(); ++o) {
-            const string& base = o->first;
-            qualsums[base] += sample.qualSum(base);
+        Sample& sample = **s;
+        for (int i = 0; i < (int) sample.alleleObservations.size() && i < alleleCount; ++i) {
+            vector<Allele*>& alleles = sample.alleleObservations[i];
+            for (vector<Allele*>::iterator a = alleles.begin(); a != alleles.end(); ++a) {
+                qualsums[i] += (*a)->quality;
+                total += (*a)->quality;
+            }
+        }
+        for (vector<Allele*>::iterator a = sample.otherObservations.begin(); a != sample.otherObservations.end(); ++a) {
+            total += (*a)->quality;
         }
     }
-    long double total = 0;
-    for (map<string, long double>::iterator q = qualsums.begin(); q != qualsums.end(); ++q) {
-        total += q->second;
-    }
-    map<string, double> freqs;
-    for (map<string, long double>::iterator q = qualsums.begin(); q != qualsums.end(); ++q) {
-        freqs[q->first] = q->second / total;
-        //cerr << "estimated frequency " << q->first << " " << freqs[q->first] << endl;
+    vector<double> freqs;
+    for (vector<ProbFloat>::iterator q = qualsums.begin(); q != qualsums.end(); ++q) {
+        freqs.push_back(total > 0 ? *q / total : 0);
     }
     return freqs;
 }
@@ -273,7 +413,7 @@ string Sample::json(void) {
 
 void groupAlleles(Samples& samples, map<string, vector<Allele*> >& alleleGroups) {
     for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-        Sample& sample = s->second;
+        Sample& sample = **s;
         for (Sample::iterator g = sample.begin(); g != sample.end(); ++g) {
             const string& base = g->first;
             const vector<Allele*>& alleles = g->second;
@@ -291,11 +431,16 @@ bool sufficientAlternateObservations(Samples& samples, int mincount, float minfr
 
     for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
 
-        //cerr << s->first << endl;
-        Sample& sample = s->second;
+        //cerr << (*s)->name << endl;
+        Sample& sample = **s;
         int alternateCount = 0;
         int observationCount = 0;
 
+        // counted reference observations are not yet in the sample's groups
+        int referenceCount = sample.referenceObservations.size();
+        totalReferenceCount += referenceCount;
+        observationCount += referenceCount;
+
         for (Sample::iterator group = sample.begin(); group != sample.end(); ++group) {
             const string& base = group->first;
             //cerr << base << endl;
@@ -335,10 +480,7 @@ int countAlleles(Samples& samples) {
 
     int count = 0;
     for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-        Sample& sample = s->second;
-        for (Sample::iterator sg = sample.begin(); sg != sample.end(); ++sg) {
-            count += sg->second.size();
-        }
+        count += (*s)->observationCount();
     }
     return count;
 
@@ -405,11 +547,10 @@ void Samples::assignPartialSupport(vector<Allele>& alleles,
     for (vector<Allele*>::iterator p = partialObservations.begin(); p != partialObservations.end(); ++p) {
         // get the sample
         Allele& partial = **p;
-        Samples::iterator siter = find(partial.sampleID);
-        if (siter == end()) {
+        Sample& sample = samples[partial.sampleIndex];
+        if (!sample.observed) {
             continue;
         }
-        Sample& sample = siter->second;
         map<Allele*, set<Allele*> >::iterator sup = partialObservationSupport.find(*p);
         if (sup != partialObservationSupport.end()) {
             set<Allele*>& supported = sup->second;
@@ -443,22 +584,35 @@ bool Sample::observationSupports(Allele* obs, Allele* allele) {
 
 void Samples::clearFullObservations(void) {
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        s->second.clear();
+        (*s)->clearFullObservations();
     }
 }
 
 void Samples::clearPartialObservations(void) {
     for (Samples::iterator s = begin(); s != end(); ++s) {
-        s->second.clearPartialObservations();
+        (*s)->clearPartialObservations();
     }
 }
 
+void Sample::clearFullObservations(void) {
+    clear();
+    referenceObservations.clear();
+    alleleObservations.clear();
+    otherObservations.clear();
+}
+
 void Sample::clearPartialObservations(void) {
     supportedAlleles.clear();
     for (Sample::iterator a = begin(); a != end(); ++a)
         supportedAlleles.insert(a->first);
     partialSupport.clear();
     reversePartials.clear();
+    partialObservations.clear();
+}
+
+void Sample::clearObservations(void) {
+    clearFullObservations();
+    clearPartialObservations();
 }
 
 void Sample::setSupportedAlleles(void) {
@@ -468,5 +622,5 @@ void Sample::setSupportedAlleles(void) {
 
 void Samples::setSupportedAlleles(void) {
     for (Samples::iterator s = begin(); s != end(); ++s)
-        s->second.setSupportedAlleles();
+        (*s)->setSupportedAlleles();
 }
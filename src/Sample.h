@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
 #include <utility>
 #include "Utility.h"
 #include "Allele.h"
@@ -33,6 +34,21 @@ StrandBaseCounts(int fr,
 
 };
 
+// a partial observation of a sample, and the genotype alleles it supports
+class PartialObservation {
+
+public:
+    Allele* allele;
+    vector<int> supported; // ordinals of the genotype alleles it supports
+    int supportCount;      // the alleles it supports, as counted when partial support was assigned
+
+    PartialObservation(Allele* a, int c)
+        : allele(a)
+        , supportCount(c)
+    { }
+
+};
+
 // sample tracking and allele sorting
 class Sample : public map<string, vector<Allele*> > {
 
@@ -40,6 +56,15 @@ class Sample : public map<string, vector<Allele*> > {
 
 public:
 
+    string name;
+    int index;      // in the samples of the analysis
+    bool observed;  // at the current site
+
+    Sample(void)
+        : index(-1)
+        , observed(false)
+    { }
+
     // includes both fully and partially-supported observations after adding partial obs
     set<string> supportedAlleles;
     void setSupportedAlleles(void);
@@ -50,11 +75,30 @@ public:
     // for fast scaling of qualities for partial supports
     map<Allele*, set<Allele*> > reversePartials;
 
-    // clear the above
+    // the observations by genotype allele, indexed by the allele's ordinal
+    // among the genotype alleles of the site, as grouped by
+    // Samples::groupByGenotypeAlleles
+    vector<vector<Allele*> > alleleObservations;
+    vector<Allele*> otherObservations;  // of alleles which are not genotype alleles
+    vector<PartialObservation> partialObservations;
+
+    // the reference observations of a single-base site, counted as the
+    // alleles of the site are gathered but neither updated to the site nor
+    // grouped by base until Samples::addReferenceObservations, so that the
+    // many sites which are not called cost one count per reference read
+    vector<Allele*> referenceObservations;
+
+    // the number of observations of the genotype allele with the given ordinal
+    int alleleObservationCount(int ordinal);
+
+    // clear the full observations, and their grouping by genotype allele
+    void clearFullObservations(void);
+
+    // clear the partial observations
     void clearPartialObservations(void);
 
-    // set of partial observations (keys of the above map) cached for faster GL calculation
-    //vector<Allele*> partialObservations;
+    // clear every observation
+    void clearObservations(void);
 
     // if the observation (partial or otherwise) supports the allele
     bool observationSupports(Allele* obs, Allele* allele);
@@ -93,9 +137,61 @@ public:
 
 };
 
-class Samples : public map<string, Sample> {
+// the samples of the analysis, and their observations at the current site
+//
+// samples are indexed by their position in the sample list, with any other
+// samples which may be observed, such as the reference sample, indexed after
+// it.  iteration covers only the samples observed at the site, in index
+// order, so starting a site costs only as much as the samples last observed
+class Samples {
 public:
-    map<string, double> estimatedAlleleFrequencies(void);
+
+    typedef vector<Sample*>::iterator iterator;
+
+    // names the samples by index, forgetting any observations
+    void setNames(const vector<string>& names);
+
+    // the number of samples which may be observed
+    int sampleCount(void) { return samples.size(); }
+
+    // starts the observations of a site, clearing the full observations of
+    // the samples observed at the last
+    void beginSite(void);
+
+    // the sample with the given index, marking it observed at the site
+    Sample& observe(int index);
+
+    // ends the observations of a site; samples observed at the last site but
+    // not this one lose their partial observations, so that only samples
+    // observed at successive sites keep them
+    void endSite(void);
+
+    // the sample with the given index, whether or not it is observed at the site
+    Sample& at(int index) { return samples[index]; }
+
+    iterator begin(void) { return observedSamples.begin(); }
+    iterator end(void) { return observedSamples.end(); }
+    int size(void) { return observedSamples.size(); }
+    bool empty(void) { return observedSamples.empty(); }
+
+    // stops observing the sample at the site, returning the next
+    iterator erase(iterator s);
+
+    // forgets every observation of every sample
+    void clear(void);
+
+    // updates the counted reference observations of each observed sample
+    // to the current site and adds them to its observations; needed before
+    // anything reads the observations of a site one by one
+    void addReferenceObservations(void);
+
+    // groups the observations of each observed sample by genotype allele
+    void groupByGenotypeAlleles(vector<Allele>& genotypeAlleles);
+
+    // the frequency of each of the alleleCount genotype alleles, by ordinal,
+    // estimated from the quality sums of its observations
+    vector<double> estimatedAlleleFrequencies(int alleleCount);
+
     void assignPartialSupport(vector<Allele>& alleles,
                               vector<Allele*>& partialObservations,
                               map<string, vector<Allele*> >& partialObservationGroups,
@@ -122,6 +218,11 @@ public:
     void clearFullObservations(void);
     void clearPartialObservations(void);
     void setSupportedAlleles(void);
+
+private:
+    deque<Sample> samples;           // by index, so references to them stay valid
+    vector<Sample*> observedSamples; // at the current site
+    vector<Sample*> lastObserved;    // at the last site, until the current one ends
 };
 
 
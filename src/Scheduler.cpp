@@ -0,0 +1,204 @@
+#include "Scheduler.h"
+
+RegionScheduler::RegionScheduler(vector<BedTarget>& targets, int unitSize, int maxPending)
+    : nextUnit(0)
+    , nextWrite(0)
+    , maxPending(maxPending)
+{
+
+    // split each target into units of at most unitSize bp, or, if unitSize is
+    // 0, use each target as a unit
+    // targets are iterated over [left, right), see AlleleParser::toNextPosition
+    for (vector<BedTarget>::iterator t = targets.begin(); t != targets.end(); ++t) {
+        if (unitSize <= 0) {
+            units.push_back(WorkUnit(*t));
+            continue;
+        }
+        int left = t->left;
+        do {
+            int right = min(left + unitSize, t->right);
+            units.push_back(WorkUnit(BedTarget(t->seq, left, right, t->desc)));
+            left = right;
+        } while (left < t->right);
+    }
+
+    // sort the units so that their output can be concatenated
+    map<string, int> sequenceOrder;
+    for (vector<BedTarget>::iterator t = targets.begin(); t != targets.end(); ++t) {
+        if (sequenceOrder.find(t->seq) == sequenceOrder.end()) {
+            int order = sequenceOrder.size();
+            sequenceOrder[t->seq] = order;
+        }
+    }
+    stable_sort(units.begin(), units.end(), WorkUnitOrder(sequenceOrder));
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&unitCompleted, NULL);
+    pthread_cond_init(&unitWritten, NULL);
+
+}
+
+RegionScheduler::~RegionScheduler(void) {
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&unitCompleted);
+    pthread_cond_destroy(&unitWritten);
+}
+
+bool RegionScheduler::claim(int& unit) {
+    pthread_mutex_lock(&mutex);
+    // don't run too far ahead of the output, or we will accumulate the
+    // results of many units in memory while waiting on a slow one
+    while (nextUnit < (int) units.size() && nextUnit >= nextWrite + maxPending) {
+        pthread_cond_wait(&unitWritten, &mutex);
+    }
+    bool claimed = nextUnit < (int) units.size();
+    if (claimed) {
+        unit = nextUnit++;
+    }
+    pthread_mutex_unlock(&mutex);
+    return claimed;
+}
+
+void RegionScheduler::complete(int unit, const string& vcf, const string& failed) {
+    pthread_mutex_lock(&mutex);
+    WorkUnit& u = units.at(unit);
+    u.vcf = vcf;
+    u.failed = failed;
+    u.done = true;
+    pthread_cond_broadcast(&unitCompleted);
+    pthread_mutex_unlock(&mutex);
+}
+
+unsigned long regionSignature(const vector<BedTarget>& regions) {
+    unsigned long hash = 5381;
+    for (vector<BedTarget>::const_iterator r = regions.begin(); r != regions.end(); ++r) {
+        stringstream region;
+        region << r->seq << ":" << r->left << "-" << r->right << ";";
+        string s = region.str();
+        for (string::iterator c = s.begin(); c != s.end(); ++c) {
+            hash = hash * 33 + *c;
+        }
+    }
+    return hash;
+}
+
+// the checkpoint of one run can't be used to resume another over different units
+unsigned long RegionScheduler::signature(void) {
+    return regionSignature(unitRegions());
+}
+
+vector<BedTarget> RegionScheduler::unitRegions(void) {
+    vector<BedTarget> regions;
+    for (vector<WorkUnit>::iterator u = units.begin(); u != units.end(); ++u) {
+        regions.push_back(u->target);
+    }
+    return regions;
+}
+
+void RegionScheduler::resume(Checkpoint& checkpoint) {
+    if (checkpoint.unitCount != (int) units.size()
+        || checkpoint.signature != signature()
+        || checkpoint.written > (int) units.size()) {
+        cerr << "ERROR(freebayes): checkpoint " << checkpoint.file
+             << " was saved by a run over different regions";
+        if (checkpoint.units.empty()) {
+            // checkpoints which don't record their units are resumed by
+            // planning them again, which gives the same units only with the
+            // same --threads
+            cerr << ", or with a different --threads";
+        }
+        cerr << endl;
+        exit(1);
+    }
+    for (int u = 0; u < checkpoint.written; ++u) {
+        units.at(u).done = true;
+    }
+    nextUnit = checkpoint.written;
+    nextWrite = checkpoint.written;
+    ownedBounds = checkpoint.ownedBounds;
+}
+
+// the output is flushed, and written through to disk, before the checkpoint
+// records its length
+void RegionScheduler::saveCheckpoint(ostream& out, ostream& failedOut, Checkpoint& checkpoint) {
+    out.flush();
+    failedOut.flush();
+    checkpoint.syncOutputFiles();
+    checkpoint.unitCount = units.size();
+    checkpoint.units = unitRegions();
+    checkpoint.signature = regionSignature(checkpoint.units);
+    checkpoint.written = nextWrite;
+    checkpoint.outputOffset = max((long int) out.tellp(), 0L);
+    checkpoint.failedOffset = max((long int) failedOut.tellp(), 0L);
+    checkpoint.ownedBounds = ownedBounds;
+    checkpoint.save();
+}
+
+void RegionScheduler::write(ostream& out, ostream& failedOut, Checkpoint* checkpoint) {
+
+    time_t lastCheckpoint = time(NULL);
+
+    while (nextWrite < (int) units.size()) {
+
+        string vcf, failed;
+
+        pthread_mutex_lock(&mutex);
+        WorkUnit& unit = units.at(nextWrite);
+        while (!unit.done) {
+            pthread_cond_wait(&unitCompleted, &mutex);
+        }
+        vcf.swap(unit.vcf);
+        failed.swap(unit.failed);
+        pthread_mutex_unlock(&mutex);
+
+        writeRecords(out, unit, vcf);
+        failedOut << failed;
+
+        pthread_mutex_lock(&mutex);
+        ++nextWrite;
+        pthread_cond_broadcast(&unitWritten);
+        pthread_mutex_unlock(&mutex);
+
+        if (checkpoint && time(NULL) - lastCheckpoint >= CHECKPOINT_INTERVAL) {
+            saveCheckpoint(out, failedOut, *checkpoint);
+            lastCheckpoint = time(NULL);
+        }
+
+    }
+
+    out.flush();
+
+}
+
+// records are owned by the unit in which they are first called, either
+// because their position lies in its region or because they begin inside a
+// record it called
+void RegionScheduler::writeRecords(ostream& out, WorkUnit& unit, const string& vcf) {
+
+    long int& bound = ownedBounds[unit.target.seq];
+    long int earlierBound = bound;
+
+    size_t start = 0;
+    while (start < vcf.size()) {
+        size_t end = vcf.find('\n', start);
+        if (end == string::npos) {
+            end = vcf.size();
+        }
+        // CHROM \t POS \t ID \t REF \t ...
+        size_t posStart = vcf.find('\t', start) + 1;
+        size_t idStart = vcf.find('\t', posStart) + 1;
+        size_t refStart = vcf.find('\t', idStart) + 1;
+        size_t refEnd = vcf.find('\t', refStart);
+        // VCF positions are 1-based, and unit bounds 0-based
+        long int position = atol(vcf.substr(posStart, idStart - posStart - 1).c_str()) - 1;
+        if (position >= earlierBound) {
+            out.write(vcf.data() + start, end - start);
+            out << '\n';
+            bound = max(bound, position + (long int) (refEnd - refStart));
+        }
+        start = end + 1;
+    }
+
+    bound = max(bound, (long int) unit.target.right);
+
+}
@@ -0,0 +1,120 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "BedReader.h"
+#include "Checkpoint.h"
+
+using namespace std;
+
+// the maximum length of the regions into which targets are split for
+// processing by worker threads
+#define DEFAULT_WORK_UNIT_SIZE 1000000
+
+// the number of units per thread which may be processed ahead of the output
+#define PENDING_WORK_UNITS_PER_THREAD 4
+
+// a hash of the regions, in order
+unsigned long regionSignature(const vector<BedTarget>& regions);
+
+// a region processed independently by one worker thread, and its output
+class WorkUnit {
+
+public:
+
+    BedTarget target;
+    bool done;
+    string vcf;     // VCF records called in the unit
+    string failed;  // BED records of alleles which failed --pvar
+
+    WorkUnit(const BedTarget& t)
+        : target(t)
+        , done(false)
+    { }
+
+};
+
+// orders work units by sequence, in the order in which sequences first appear
+// in the targets, and then by left position
+class WorkUnitOrder {
+
+public:
+
+    map<string, int>& sequenceOrder;
+
+    WorkUnitOrder(map<string, int>& o) : sequenceOrder(o) { }
+
+    bool operator()(const WorkUnit& a, const WorkUnit& b) {
+        if (a.target.seq != b.target.seq) {
+            return sequenceOrder[a.target.seq] < sequenceOrder[b.target.seq];
+        } else {
+            return a.target.left < b.target.left;
+        }
+    }
+
+};
+
+// hands out work units to worker threads as they become free, and collects
+// their output so that it can be written in order
+//
+// each record is owned by the first unit whose region contains its position,
+// and a record which begins inside a record written by an earlier unit, such
+// as a haplotype extending past the end of its unit, is owned by that unit
+// too.  as units are sorted, writing the records each unit owns in unit order
+// gives a sorted stream in which no variant is reported twice.
+class RegionScheduler {
+
+public:
+
+    vector<WorkUnit> units;
+
+    RegionScheduler(vector<BedTarget>& targets, int unitSize, int maxPending);
+    ~RegionScheduler(void);
+
+    // claims the next unit, blocking if too many units are awaiting output
+    // returns false once every unit has been claimed
+    bool claim(int& unit);
+
+    // stores the output of a processed unit
+    void complete(int unit, const string& vcf, const string& failed);
+
+    // skips the units written before the checkpoint was saved
+    // must be called before any unit is claimed
+    void resume(Checkpoint& checkpoint);
+
+    // writes the output of each unit in order as it completes, removing
+    // records owned by earlier units
+    // if a checkpoint is given, it is updated as units are written
+    // returns once all units have been written
+    void write(ostream& out, ostream& failedOut, Checkpoint* checkpoint = NULL);
+
+private:
+
+    int nextUnit;   // the next unit to be claimed
+    int nextWrite;  // the next unit to be written
+    int maxPending; // the maximum number of claimed but unwritten units
+
+    pthread_mutex_t mutex;
+    pthread_cond_t unitCompleted;
+    pthread_cond_t unitWritten;
+
+    // by sequence, the 0-based position before which all records are owned
+    // by units which have been written
+    map<string, long int> ownedBounds;
+
+    void writeRecords(ostream& out, WorkUnit& unit, const string& vcf);
+    void saveCheckpoint(ostream& out, ostream& failedOut, Checkpoint& checkpoint);
+    unsigned long signature(void);
+    vector<BedTarget> unitRegions(void);
+
+};
+
+#endif
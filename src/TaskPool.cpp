@@ -0,0 +1,109 @@
+#include "TaskPool.h"
+
+TaskPool::TaskPool(int threads)
+    : task(NULL)
+    , data(NULL)
+    , count(0)
+    , next(0)
+    , remaining(0)
+    , batch(0)
+    , stopping(false)
+{
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&batchStarted, NULL);
+    pthread_cond_init(&batchFinished, NULL);
+    for (int i = 1; i < threads; ++i) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, &TaskPool::runWorker, this)) {
+            cerr << "ERROR(freebayes): could not start task thread" << endl;
+            exit(1);
+        }
+        workers.push_back(worker);
+    }
+}
+
+TaskPool::~TaskPool(void) {
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_broadcast(&batchStarted);
+    pthread_mutex_unlock(&mutex);
+    for (vector<pthread_t>::iterator w = workers.begin(); w != workers.end(); ++w) {
+        pthread_join(*w, NULL);
+    }
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&batchStarted);
+    pthread_cond_destroy(&batchFinished);
+}
+
+void TaskPool::run(int count, void (*task)(int, void*), void* data) {
+
+    if (workers.empty() || count < 2) {
+        for (int i = 0; i < count; ++i) {
+            task(i, data);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&mutex);
+    this->task = task;
+    this->data = data;
+    this->count = count;
+    next = 0;
+    remaining = count;
+    unsigned long seen = ++batch;
+    pthread_cond_broadcast(&batchStarted);
+    pthread_mutex_unlock(&mutex);
+
+    runTasks(seen);
+
+    pthread_mutex_lock(&mutex);
+    while (remaining > 0) {
+        pthread_cond_wait(&batchFinished, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+
+}
+
+void TaskPool::runTasks(unsigned long seen) {
+    pthread_mutex_lock(&mutex);
+    while (batch == seen && next < count) {
+        int i = next++;
+        void (*t)(int, void*) = task;
+        void* d = data;
+        pthread_mutex_unlock(&mutex);
+        t(i, d);
+        pthread_mutex_lock(&mutex);
+        if (--remaining == 0) {
+            pthread_cond_broadcast(&batchFinished);
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void* TaskPool::runWorker(void* pool) {
+    ((TaskPool*) pool)->work();
+    return NULL;
+}
+
+void TaskPool::work(void) {
+
+    unsigned long seen = 0;
+
+    while (true) {
+
+        pthread_mutex_lock(&mutex);
+        while (batch == seen && !stopping) {
+            pthread_cond_wait(&batchStarted, &mutex);
+        }
+        if (stopping) {
+            pthread_mutex_unlock(&mutex);
+            break;
+        }
+        seen = batch;
+        pthread_mutex_unlock(&mutex);
+
+        runTasks(seen);
+
+    }
+
+}
@@ -0,0 +1,55 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <pthread.h>
+
+using namespace std;
+
+// a fixed set of threads which run batches of independent tasks, such as the
+// per-sample steps of the calculation at a single site
+//
+// the calling thread takes part in each batch, so a pool of one thread starts
+// no threads and runs every task in order
+class TaskPool {
+
+public:
+
+    TaskPool(int threads);
+    ~TaskPool(void);
+
+    // calls task(i, data) for each i in [0, count), returning once all have
+    // completed; tasks may run in any order, and must not depend on each other
+    void run(int count, void (*task)(int, void*), void* data);
+
+    int size(void) { return workers.size() + 1; }
+
+private:
+
+    vector<pthread_t> workers;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t batchStarted;
+    pthread_cond_t batchFinished;
+
+    // the current batch
+    void (*task)(int, void*);
+    void* data;
+    int count;
+    int next;            // the next task to be claimed
+    int remaining;       // tasks not yet completed
+    unsigned long batch; // incremented as each batch starts
+    bool stopping;
+
+    // tasks are claimed under the mutex, and only while the batch is the one
+    // the thread joined, so a thread which wakes late for a batch which has
+    // finished can't claim a task of the next one
+    void runTasks(unsigned long seen);
+    void work(void);
+    static void* runWorker(void* pool);
+
+};
+
+#endif
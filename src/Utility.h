@@ -10,42 +10,59 @@
 #include <algorithm>
 #include <string>
 #include <float.h>
+#include <limits>
 #include <iostream>
 #include <fstream>
 #include <map>
 #include <time.h>
+#include <pthread.h>
 #include "convert.h"
 #include "ttmath.h"
+#include "NumericTables.h"
 
 using namespace std;
 
 typedef ttmath::Big<TTMATH_BITS(256), TTMATH_BITS(64)> BigFloat;
 
-long double factorial(int);
+// the floating point type of the probability calculations
+// long double by default; building with -DDOUBLE_PRECISION (see 'make
+// double-precision') uses double, which is faster and vectorizes, at the cost
+// of precision.  scripts/compare_precision.py measures the difference.
+#ifdef DOUBLE_PRECISION
+typedef double ProbFloat;
+#else
+typedef long double ProbFloat;
+#endif
+
+// phred base qualities, held in a byte each as in the BAM record
+typedef std::vector<unsigned char> BaseQualities;
+
+ProbFloat factorial(int);
 short qualityChar2ShortInt(char c);
-long double qualityChar2LongDouble(char c);
-long double lnqualityChar2ShortInt(char c);
+ProbFloat qualityChar2LongDouble(char c);
+ProbFloat lnqualityChar2ShortInt(char c);
 char qualityInt2Char(short i);
-//long double phred2float(int qual);
-long double phred2ln(int qual);
-long double ln2phred(long double prob);
-long double ln2log10(long double prob);
-long double log102ln(long double prob);
-long double phred2float(int qual);
-long double float2phred(long double prob);
-long double big2phred(const BigFloat& prob);
-long double nan2zero(long double x);
-long double powln(long double m, int n);
+//ProbFloat phred2float(int qual);
+ProbFloat phred2ln(int qual);
+ProbFloat ln2phred(ProbFloat prob);
+ProbFloat ln2log10(ProbFloat prob);
+ProbFloat log102ln(ProbFloat prob);
+ProbFloat phred2float(int qual);
+ProbFloat float2phred(ProbFloat prob);
+ProbFloat big2phred(const BigFloat& prob);
+ProbFloat lnprob2phred(ProbFloat ln);
+ProbFloat nan2zero(ProbFloat x);
+ProbFloat powln(ProbFloat m, int n);
 // here 'joint' means 'probability that we have a vector entirely composed of true bases'
-long double jointQuality(const std::vector<short>& quals);
-long double jointQuality(const std::string& qualstr);
-std::vector<short> qualities(const std::string& qualstr);
+ProbFloat jointQuality(const BaseQualities& quals);
+ProbFloat jointQuality(const std::string& qualstr);
+BaseQualities qualities(const std::string& qualstr);
 // 
-long double sumQuality(const std::string& qualstr);
-long double minQuality(const std::string& qualstr);
-short minQuality(const std::vector<short>& qualities);
-long double averageQuality(const std::string& qualstr);
-long double averageQuality(const std::vector<short>& qualities);
+ProbFloat sumQuality(const std::string& qualstr);
+ProbFloat minQuality(const std::string& qualstr);
+short minQuality(const BaseQualities& qualities);
+ProbFloat averageQuality(const std::string& qualstr);
+ProbFloat averageQuality(const BaseQualities& qualities);
 //unsigned int factorial(int n);
 bool stringInVector(string item, vector<string> items);
 int upper(int c); // helper to below, wraps toupper
@@ -54,87 +71,72 @@ bool allATGC(string& s);
 string strip(string const& str, char const* separators = " \t");
 
 int binomialCoefficient(int n, int k);
-long double binomialCoefficientLn(int k, int n);
-long double binomialProb(int k, int n, long double p);
-long double __binomialProbln(int k, int n, long double p);
-long double binomialProbln(int k, int n, long double p);
-
-long double poissonpln(int observed, int expected);
-long double poissonp(int observed, int expected);
-long double poissonPvalLn(int a, int b);
-
-long double gammaln( long double x);
-long double factorial( int n);
-double factorialln( int n);
-long double __factorialln( int n);
-
-#define MAX_FACTORIAL_CACHE_SIZE 100000
-
-class FactorialCache : public map<int, long double> {
+ProbFloat binomialCoefficientLn(int k, int n);
+ProbFloat binomialProb(int k, int n, ProbFloat p);
+ProbFloat binomialProbln(int k, int n, ProbFloat p);
+
+ProbFloat poissonpln(int observed, int expected);
+ProbFloat poissonp(int observed, int expected);
+ProbFloat poissonPvalLn(int a, int b);
+
+ProbFloat gammaln( ProbFloat x);
+ProbFloat factorial( int n);
+
+// holds one instance of T for each thread which uses it, constructed on first
+// use, so that caches, such as that of the allele frequency probabilities, can
+// be used by worker threads without locking
+template <class T>
+class ThreadLocal {
 public:
-    long double factorialln(int n) {
-        map<int, long double>::iterator f = find(n);
-        if (f == end()) {
-            if (size() > MAX_FACTORIAL_CACHE_SIZE) {
-                clear();
-            }
-            long double fln = __factorialln(n);
-            insert(make_pair(n, fln));
-            return fln;
-        } else {
-            return f->second;
-        }
+    ThreadLocal(void) {
+        pthread_key_create(&key, &ThreadLocal<T>::destroy);
     }
-};
-
-#define MAX_BINOMIAL_CACHE_SIZE 100000
-
-class BinomialCache : public map<long double, map<pair<int, int>, long double> > {
-public:
-    long double binomialProbln(int k, int n, long double p) {
-        map<pair<int, int>, long double>& t = (*this)[p];
-        pair<int, int> kn = make_pair(k, n);
-        map<pair<int, int>, long double>::iterator f = t.find(kn);
-        if (f == t.end()) {
-            if (t.size() > MAX_BINOMIAL_CACHE_SIZE) {
-                t.clear();
-            }
-            long double bln = __binomialProbln(k, n, p);
-            t.insert(make_pair(kn, bln));
-            return bln;
-        } else {
-            return f->second;
+    T& get(void) {
+        T* t = (T*) pthread_getspecific(key);
+        if (!t) {
+            t = new T;
+            pthread_setspecific(key, t);
         }
+        return *t;
+    }
+private:
+    pthread_key_t key;
+    static void destroy(void* t) {
+        delete (T*) t;
     }
 };
 
-long double cofactor( int n, int i);
-long double cofactorln( int n, int i);
+ProbFloat cofactor( int n, int i);
+ProbFloat cofactorln( int n, int i);
 
-long double harmonicSum(int n);
+ProbFloat harmonicSum(int n);
 
-long double safedivide(long double a, long double b);
+ProbFloat safedivide(ProbFloat a, ProbFloat b);
 
-long double safe_exp(long double ln);
+ProbFloat safe_exp(ProbFloat ln);
 
-BigFloat big_exp(long double ln);
+BigFloat big_exp(ProbFloat ln);
 
-long double logsumexp_probs(const vector<long double>& lnv);
-long double logsumexp(const vector<long double>& lnv);
+// posterior probabilities are summed in log space, in ProbFloat
+// building with -DBIGFLOAT_POSTERIORS (see 'make bigfloat-posteriors') sums
+// them as BigFloats instead, as a check on the log space sums
+ProbFloat logsumexp_probs(const vector<ProbFloat>& lnv);
+ProbFloat log1mexp(ProbFloat ln);
+ProbFloat logsumexp(const vector<ProbFloat>& lnv);
 
-long double betaln(const vector<long double>& alphas);
-long double beta(const vector<long double>& alphas);
+ProbFloat betaln(const vector<ProbFloat>& alphas);
+ProbFloat beta(const vector<ProbFloat>& alphas);
 
-long double hoeffding(double successes, double trials, double prob);
-long double hoeffdingln(double successes, double trials, double prob);
+ProbFloat hoeffding(double successes, double trials, double prob);
+ProbFloat hoeffdingln(double successes, double trials, double prob);
 
 int levenshteinDistance(const std::string source, const std::string target);
 bool isTransition(string& ref, string& alt);
 
 string dateStr(void);
 
-long double string2float(const string& s);
-long double log10string2ln(const string& s);
+ProbFloat string2float(const string& s);
+ProbFloat log10string2ln(const string& s);
 
 string mergeCigar(const string& c1, const string& c2);
 vector<pair<int, string> > splitCigar(const string& cigarStr);
@@ -145,7 +147,7 @@ bool isEmptyCigarElement(const pair<int, string>& elem);
 
 std::string operator*(std::string const &s, size_t n);
 
-void normalizeSumToOne(vector<long double>&);
+void normalizeSumToOne(vector<ProbFloat>&);
 
 void addLinesFromFile(vector<string>& v, const string& f);
 
@@ -16,6 +16,7 @@
 #include <cmath>
 #include <time.h>
 #include <float.h>
+#include <pthread.h>
 
 // private libraries
 #include "api/BamReader.h"
@@ -38,6 +39,9 @@
 
 #include "Bias.h"
 #include "Contamination.h"
+#include "Scheduler.h"
+#include "TaskPool.h"
+#include "RegionPlanner.h"
 
 
 // local helper debugging macros to improve code readability
@@ -57,39 +61,184 @@
     cerr << msg << endl;
 
 
-using namespace std; 
+using namespace std;
 
+// the data likelihoods of one sample's genotypes at the current site
+class SampleLikelihoodTask {
 
-// freebayes main
-int main (int argc, char *argv[]) {
+public:
 
-    // install segfault handler
-    signal(SIGSEGV, segfaultHandler);
+    string name;
+    Sample* sample;
+    vector<Genotype*> genotypes;
+    vector<pair<Genotype*, ProbFloat> > probs;
 
-    AlleleParser* parser = new AlleleParser(argc, argv);
-    Parameters& parameters = parser->parameters;
-    list<Allele*> alleles;
+    SampleLikelihoodTask(const string& n, Sample& s)
+        : name(n)
+        , sample(&s)
+    { }
 
-    Samples samples;
+};
 
-    ostream& out = *(parser->output);
+// the samples evaluated at the current site, and the inputs they share
+class SampleLikelihoodBatch {
 
-    Bias observationBias;
-    if (!parameters.alleleObservationBiasFile.empty()) {
-        observationBias.open(parameters.alleleObservationBiasFile);
-    }
+public:
 
-    Contamination contaminationEstimates(0.5+parameters.probContamination, parameters.probContamination);
-    if (!parameters.contaminationEstimateFile.empty()) {
-        contaminationEstimates.open(parameters.contaminationEstimateFile);
+    Parameters& parameters;
+    Bias& observationBias;
+    vector<Allele>& genotypeAlleles;
+    Contamination& contaminationEstimates;
+    vector<double>& estimatedAlleleFrequencies;
+    vector<SampleLikelihoodTask> samples;
+
+    SampleLikelihoodBatch(Parameters& p, Bias& b, vector<Allele>& a,
+                          Contamination& c, vector<double>& f)
+        : parameters(p)
+        , observationBias(b)
+        , genotypeAlleles(a)
+        , contaminationEstimates(c)
+        , estimatedAlleleFrequencies(f)
+    { }
+
+};
+
+// each task reads only its own sample, so tasks may run concurrently
+void calculateSampleLikelihoods(int i, void* arg) {
+    SampleLikelihoodBatch& batch = *(SampleLikelihoodBatch*) arg;
+    SampleLikelihoodTask& task = batch.samples.at(i);
+    task.probs = probObservedAllelesGivenGenotypes(*task.sample, task.genotypes,
+                                                   batch.parameters.RDF, batch.parameters.useMappingQuality,
+                                                   batch.observationBias, batch.parameters.standardGLs,
+                                                   batch.genotypeAlleles,
+                                                   batch.contaminationEstimates,
+                                                   batch.estimatedAlleleFrequencies);
+}
+
+// the genotype combination search of one population at the current site
+class PopulationSearchTask {
+
+public:
+
+    SampleDataLikelihoods* sampleDataLikelihoods;
+    list<GenotypeCombo>* combos;
+    list<GenotypeCombo>* glMaxCombos; // NULL unless reporting the GL maximum
+    int iterations;
+
+    PopulationSearchTask(SampleDataLikelihoods& s, list<GenotypeCombo>& c, list<GenotypeCombo>* g)
+        : sampleDataLikelihoods(&s)
+        , combos(&c)
+        , glMaxCombos(g)
+        , iterations(0)
+    { }
+
+};
+
+// the populations searched at the current site, and the inputs they share
+class PopulationSearchBatch {
+
+public:
+
+    Parameters& parameters;
+    Samples& samples;
+    vector<Allele>& genotypeAlleles;
+    map<string, int>& inputAlleleCounts;
+    int bandwidth;
+    int banddepth;
+    ProbFloat theta;
+    int itermax;
+    vector<PopulationSearchTask> populations;
+
+    PopulationSearchBatch(Parameters& p, Samples& s, vector<Allele>& a, map<string, int>& c,
+                          int bw, int bd, ProbFloat t, int i)
+        : parameters(p)
+        , samples(s)
+        , genotypeAlleles(a)
+        , inputAlleleCounts(c)
+        , bandwidth(bw)
+        , banddepth(bd)
+        , theta(t)
+        , itermax(i)
+    { }
+
+};
+
+// the samples, input allele counts and genotypes are only read during the
+// search, and each population has its own data likelihoods
+void searchPopulationGenotypeCombos(int i, void* arg) {
+
+    PopulationSearchBatch& batch = *(PopulationSearchBatch*) arg;
+    PopulationSearchTask& task = batch.populations.at(i);
+    Parameters& parameters = batch.parameters;
+    SampleDataLikelihoods& sampleDataLikelihoods = *task.sampleDataLikelihoods;
+
+    GenotypeCombo nullCombo;
+    SampleDataLikelihoods nullSampleDataLikelihoods;
+
+    // this is the genotype-likelihood maximum
+    if (task.glMaxCombos) {
+        GenotypeCombo comboKing;
+        vector<int> initialPosition;
+        initialPosition.assign(sampleDataLikelihoods.size(), 0);
+        SampleDataLikelihoods nullDataLikelihoods; // dummy variable
+        makeComboByDatalLikelihoodRank(comboKing,
+                                       initialPosition,
+                                       sampleDataLikelihoods,
+                                       nullDataLikelihoods,
+                                       batch.inputAlleleCounts,
+                                       batch.theta,
+                                       parameters.pooledDiscrete,
+                                       parameters.ewensPriors,
+                                       parameters.permute,
+                                       parameters.hwePriors,
+                                       parameters.obsBinomialPriors,
+                                       parameters.alleleBalancePriors,
+                                       parameters.diffusionPriorScalar);
+
+        task.glMaxCombos->push_back(comboKing);
     }
 
-    // this can be uncommented to force operation on a specific set of genotypes
-    vector<Allele> allGenotypeAlleles;
-    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "A", 1));
-    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "T", 1));
-    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "G", 1));
-    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "C", 1));
+    // search much longer for convergence
+    convergentGenotypeComboSearch(
+        *task.combos,
+        nullCombo,
+        sampleDataLikelihoods, // vary everything
+        sampleDataLikelihoods,
+        nullSampleDataLikelihoods,
+        batch.samples,
+        batch.genotypeAlleles,
+        batch.inputAlleleCounts,
+        batch.bandwidth,
+        batch.banddepth,
+        batch.theta,
+        parameters.pooledDiscrete,
+        parameters.ewensPriors,
+        parameters.permute,
+        parameters.hwePriors,
+        parameters.obsBinomialPriors,
+        parameters.alleleBalancePriors,
+        parameters.diffusionPriorScalar,
+        batch.itermax,
+        task.iterations,
+        true); // add homozygous combos
+        // ^^ combo results are sorted by default
+
+}
+
+// calls variants at each position the parser steps through, writing records
+// to out and, when --failed-alleles is given, alleles which fail --pvar to
+// failedOut
+void callVariants(AlleleParser* parser,
+                  ostream& out,
+                  ostream& failedOut,
+                  Bias& observationBias,
+                  Contamination& contaminationEstimates,
+                  unsigned long& total_sites,
+                  unsigned long& processed_sites) {
+
+    Parameters& parameters = parser->parameters;
+    Samples samples;
+    TaskPool pool(parameters.siteThreads);
 
     int allowedAlleleTypes = ALLELE_REFERENCE;
     if (parameters.allowSNPs) {
@@ -106,15 +255,13 @@ int main (int argc, char *argv[]) {
         allowedAlleleTypes |= ALLELE_COMPLEX;
     }
 
-    // output VCF header
-    if (parameters.output == "vcf") {
-        out << parser->variantCallFile.header << endl;
-    }
-
     Allele nullAllele = genotypeAllele(ALLELE_NULL, "N", 1, "1N");
 
-    unsigned long total_sites = 0;
-    unsigned long processed_sites = 0;
+    // positions without alternate observations are passed over below unless
+    // we report monomorphic sites or trace every position, so the parser
+    // need not stop at them
+    parser->skipUninformativePositions = !parameters.reportMonomorphic && !parameters.trace
+        && (parameters.minAltCount > 0 || parameters.minAltFraction > 0);
 
     while (parser->getNextAlleles(samples, allowedAlleleTypes)) {
 
@@ -130,14 +277,15 @@ int main (int argc, char *argv[]) {
         }
 
         if (parameters.trace) {
+            samples.addReferenceObservations();
             for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-                const string& name = s->first;
-                for (Sample::iterator g = s->second.begin(); g != s->second.end(); ++g) {
+                const string& name = (*s)->name;
+                for (Sample::iterator g = (*s)->begin(); g != (*s)->end(); ++g) {
                     vector<Allele*>& group = g->second;
                     for (vector<Allele*>::iterator a = group.begin(); a != group.end(); ++a) {
                         Allele& allele = **a;
                         parser->traceFile << parser->currentSequenceName << "," << (long unsigned int) parser->currentPosition + 1  
-                                          << ",allele," << name << "," << allele.readID << "," << allele.base() << ","
+                                          << ",allele," << name << "," << *allele.readID << "," << allele.base() << ","
                                           << allele.currentQuality() << "," << allele.mapQuality << endl;
                     }
                 }
@@ -190,6 +338,10 @@ int main (int argc, char *argv[]) {
             */
         }
 
+        // the site will be called, so its reference observations are needed
+        // one by one from here on
+        samples.addReferenceObservations();
+
         // to ensure proper ordering of output stream
         vector<string> sampleListPlusRef;
 
@@ -235,8 +387,8 @@ int main (int argc, char *argv[]) {
 
         /* for debugging
         for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
-            string sampleName = s->first;
-            Sample& sample = s->second;
+            string sampleName = (*s)->name;
+            Sample& sample = **s;
             cerr << sampleName << ": " << sample << endl;
         }
         */
@@ -245,7 +397,7 @@ int main (int argc, char *argv[]) {
         coverage = countAlleles(samples);
 
         // estimate theta using the haplotype length
-        long double theta = parameters.TH * parser->lastHaplotypeLength;
+        ProbFloat theta = parameters.TH * parser->lastHaplotypeLength;
 
         // if we have only one viable allele, we don't have evidence for variation at this site
         if (!parser->hasInputVariantAllelesAtCurrentPosition() && !parameters.reportMonomorphic && genotypeAlleles.size() <= 1 && genotypeAlleles.front().isReference()) {
@@ -263,6 +415,10 @@ int main (int argc, char *argv[]) {
 
         ++processed_sites;
 
+        // the genotype alleles are settled, so the observations of each
+        // sample can be grouped by them
+        samples.groupByGenotypeAlleles(genotypeAlleles);
+
         // generate possible genotypes
 
         // for each possible ploidy in the dataset, generate all possible genotypes
@@ -282,10 +438,15 @@ int main (int argc, char *argv[]) {
         }
 
         // get estimated allele frequencies using sum of estimated qualities
-        map<string, double> estimatedAlleleFrequencies = samples.estimatedAlleleFrequencies();
+        vector<double> estimatedAlleleFrequencies = samples.estimatedAlleleFrequencies(genotypeAlleles.size());
         double estimatedMaxAlleleFrequency = 0;
         double estimatedMaxAlleleCount = 0;
-        double estimatedMajorFrequency = estimatedAlleleFrequencies[referenceBase];
+        double estimatedMajorFrequency = 0;
+        for (int i = 0; i < (int) genotypeAlleles.size(); ++i) {
+            if (genotypeAlleles[i].currentBase == referenceBase) {
+                estimatedMajorFrequency = estimatedAlleleFrequencies[i];
+            }
+        }
         if (estimatedMajorFrequency < 0.5) estimatedMajorFrequency = 1-estimatedMajorFrequency;
         double estimatedMinorFrequency = 1-estimatedMajorFrequency;
         //cerr << "num copies of locus " << numCopiesOfLocus << endl;
@@ -304,6 +465,10 @@ int main (int argc, char *argv[]) {
 
         DEBUG2("calculating data likelihoods");
         // calculate data likelihoods
+        // the samples and genotypes to evaluate are gathered first, so that the
+        // likelihoods may be calculated in parallel and then merged in sample order
+        SampleLikelihoodBatch batch(parameters, observationBias, genotypeAlleles,
+                                    contaminationEstimates, estimatedAlleleFrequencies);
         //for (Samples::iterator s = samples.begin(); s != samples.end(); ++s) {
         for (vector<string>::iterator n = parser->sampleList.begin(); n != parser->sampleList.end(); ++n) {
 
@@ -311,12 +476,12 @@ int main (int argc, char *argv[]) {
             string& sampleName = *n;
             //DEBUG2("sample: " << sampleName);
             //Sample& sample = s->second;
-            if (samples.find(sampleName) == samples.end()
+            Sample& sample = samples.at(n - parser->sampleList.begin());
+            if (!sample.observed
                 && !(parser->hasInputVariantAllelesAtCurrentPosition()
                      || parameters.reportMonomorphic)) {
                 continue;
             }
-            Sample& sample = samples[sampleName];
             vector<Genotype>& genotypes = genotypesByPloidy[parser->currentSamplePloidy(sampleName)];
             vector<Genotype*> genotypesWithObs;
             for (vector<Genotype>::iterator g = genotypes.begin(); g != genotypes.end(); ++g) {
@@ -343,17 +508,22 @@ int main (int argc, char *argv[]) {
                 continue;
             }
 
-            vector<pair<Genotype*, long double> > probs
-                = probObservedAllelesGivenGenotypes(sample, genotypesWithObs,
-                                                    parameters.RDF, parameters.useMappingQuality,
-                                                    observationBias, parameters.standardGLs,
-                                                    genotypeAlleles,
-                                                    contaminationEstimates,
-                                                    estimatedAlleleFrequencies);
-            
+            batch.samples.push_back(SampleLikelihoodTask(sampleName, sample));
+            batch.samples.back().genotypes.swap(genotypesWithObs);
+
+        }
+
+        pool.run(batch.samples.size(), &calculateSampleLikelihoods, &batch);
+
+        for (vector<SampleLikelihoodTask>::iterator t = batch.samples.begin(); t != batch.samples.end(); ++t) {
+
+            string& sampleName = t->name;
+            Sample& sample = *t->sample;
+            vector<pair<Genotype*, ProbFloat> >& probs = t->probs;
+
 #ifdef VERBOSE_DEBUG
             if (parameters.debug2) {
-                for (vector<pair<Genotype*, long double> >::iterator p = probs.begin(); p != probs.end(); ++p) {
+                for (vector<pair<Genotype*, ProbFloat> >::iterator p = probs.begin(); p != probs.end(); ++p) {
                     cerr << parser->currentSequenceName << "," << (long unsigned int) parser->currentPosition + 1 << ","
                          << sampleName << ",likelihood," << *(p->first) << "," << p->second << endl;
                 }
@@ -363,7 +533,7 @@ int main (int argc, char *argv[]) {
             Result& sampleData = results[sampleName];
             sampleData.name = sampleName;
             sampleData.observations = &sample;
-            for (vector<pair<Genotype*, long double> >::iterator p = probs.begin(); p != probs.end(); ++p) {
+            for (vector<pair<Genotype*, ProbFloat> >::iterator p = probs.begin(); p != probs.end(); ++p) {
                 sampleData.push_back(SampleDataLikelihood(sampleName, &sample, p->first, p->second, 0));
             }
 
@@ -449,10 +619,10 @@ int main (int argc, char *argv[]) {
         // the approach is go through all the homozygous combos
         // and then subtract this from 1... resolving p(var|d)
 
-        BigFloat pVar = 1.0;
-        BigFloat pHom = 0.0;
+        ProbFloat pVarln = 0;
+        ProbFloat pHomln = -numeric_limits<ProbFloat>::infinity();
 
-        long double bestComboOddsRatio = 0;
+        ProbFloat bestComboOddsRatio = 0;
 
         bool bestOverallComboIsHet = false;
         GenotypeCombo bestCombo; // = NULL;
@@ -464,12 +634,12 @@ int main (int argc, char *argv[]) {
                 vector<Genotype*> comboGenotypes;
                 for (GenotypeCombo::iterator g = gc->begin(); g != gc->end(); ++g)
                     comboGenotypes.push_back((*g)->genotype);
-                long double posteriorProb = gc->posteriorProb;
-                long double dataLikelihoodln = gc->probObsGivenGenotypes;
-                long double priorln = gc->posteriorProb;
-                long double priorlnG_Af = gc->priorProbG_Af;
-                long double priorlnAf = gc->priorProbAf;
-                long double priorlnBin = gc->priorProbObservations;
+                ProbFloat posteriorProb = gc->posteriorProb;
+                ProbFloat dataLikelihoodln = gc->probObsGivenGenotypes;
+                ProbFloat priorln = gc->posteriorProb;
+                ProbFloat priorlnG_Af = gc->priorProbG_Af;
+                ProbFloat priorlnAf = gc->priorProbAf;
+                ProbFloat priorlnBin = gc->priorProbObservations;
 
                 parser->traceFile << parser->currentSequenceName << "," << (long unsigned int) parser->currentPosition + 1 << ",genotypecombo,";
 
@@ -515,82 +685,48 @@ int main (int argc, char *argv[]) {
         int genotypingTotalIterations = 0; // tally total iterations required to reach convergence
         map<string, list<GenotypeCombo> > glMaxCombos;
 
+        // cap the number of iterations at 2 x the number of alternate alleles
+        // max it at parameters.genotypingMaxIterations iterations, min at 10
+        int itermax = min(max(10, 2 * estimatedMinorAllelesAtLocus), parameters.genotypingMaxIterations);
+        //int itermax = parameters.genotypingMaxIterations;
+
+        // XXX HACK
+        // passing 0 for bandwidth and banddepth means "exhaustive local search"
+        // this produces properly normalized GQ's at polyallelic sites
+        int adjustedBandwidth = 0;
+        int adjustedBanddepth = 0;
+        // however, this can lead to huge performance problems at complex sites,
+        // so we implement this hack...
+        if (parameters.genotypingMaxBandDepth > 0 &&
+            genotypeAlleles.size() > parameters.genotypingMaxBandDepth) {
+            adjustedBandwidth = 1;
+            adjustedBanddepth = parameters.genotypingMaxBandDepth;
+        }
+
+        // the populations are searched independently, so the searches may run
+        // in parallel; each writes only to its own entries in the combo maps,
+        // which are created here so that the maps are not modified concurrently
+        PopulationSearchBatch searches(parameters, samples, genotypeAlleles, inputAlleleCounts,
+                                       adjustedBandwidth, adjustedBanddepth, theta, itermax);
         for (map<string, SampleDataLikelihoods>::iterator p = sampleDataLikelihoodsByPopulation.begin(); p != sampleDataLikelihoodsByPopulation.end(); ++p) {
 
             const string& population = p->first;
             SampleDataLikelihoods& sampleDataLikelihoods = p->second;
-            list<GenotypeCombo>& populationGenotypeCombos = genotypeCombosByPopulation[population];
 
             DEBUG2("genqerating banded genotype combinations from " << sampleDataLikelihoods.size() << " sample genotypes in population " << population);
 
-            // cap the number of iterations at 2 x the number of alternate alleles
-            // max it at parameters.genotypingMaxIterations iterations, min at 10
-            int itermax = min(max(10, 2 * estimatedMinorAllelesAtLocus), parameters.genotypingMaxIterations);
-            //int itermax = parameters.genotypingMaxIterations;
-
-            // XXX HACK
-            // passing 0 for bandwidth and banddepth means "exhaustive local search"
-            // this produces properly normalized GQ's at polyallelic sites
-            int adjustedBandwidth = 0;
-            int adjustedBanddepth = 0;
-            // however, this can lead to huge performance problems at complex sites,
-            // so we implement this hack...
-            if (parameters.genotypingMaxBandDepth > 0 &&
-                genotypeAlleles.size() > parameters.genotypingMaxBandDepth) {
-                adjustedBandwidth = 1;
-                adjustedBanddepth = parameters.genotypingMaxBandDepth;
-            }
+            searches.populations.push_back(
+                PopulationSearchTask(sampleDataLikelihoods,
+                                     genotypeCombosByPopulation[population],
+                                     parameters.reportGenotypeLikelihoodMax ? &glMaxCombos[population] : NULL));
+        }
 
-            GenotypeCombo nullCombo;
-            SampleDataLikelihoods nullSampleDataLikelihoods;
-
-            // this is the genotype-likelihood maximum
-            if (parameters.reportGenotypeLikelihoodMax) {
-                GenotypeCombo comboKing;
-                vector<int> initialPosition;
-                initialPosition.assign(sampleDataLikelihoods.size(), 0);
-                SampleDataLikelihoods nullDataLikelihoods; // dummy variable
-                makeComboByDatalLikelihoodRank(comboKing,
-                                               initialPosition,
-                                               sampleDataLikelihoods,
-                                               nullDataLikelihoods,
-                                               inputAlleleCounts,
-                                               theta,
-                                               parameters.pooledDiscrete,
-                                               parameters.ewensPriors,
-                                               parameters.permute,
-                                               parameters.hwePriors,
-                                               parameters.obsBinomialPriors,
-                                               parameters.alleleBalancePriors,
-                                               parameters.diffusionPriorScalar);
-
-                glMaxCombos[population].push_back(comboKing);
-            }
+        pool.run(searches.populations.size(), &searchPopulationGenotypeCombos, &searches);
 
-            // search much longer for convergence
-            convergentGenotypeComboSearch(
-                populationGenotypeCombos,
-                nullCombo,
-                sampleDataLikelihoods, // vary everything
-                sampleDataLikelihoods,
-                nullSampleDataLikelihoods,
-                samples,
-                genotypeAlleles,
-                inputAlleleCounts,
-                adjustedBandwidth,
-                adjustedBanddepth,
-                theta,
-                parameters.pooledDiscrete,
-                parameters.ewensPriors,
-                parameters.permute,
-                parameters.hwePriors,
-                parameters.obsBinomialPriors,
-                parameters.alleleBalancePriors,
-                parameters.diffusionPriorScalar,
-                itermax,
-                genotypingTotalIterations,
-                true); // add homozygous combos
-                // ^^ combo results are sorted by default
+        // as when the populations were searched in turn, report the iterations
+        // of the last
+        if (!searches.populations.empty()) {
+            genotypingTotalIterations = searches.populations.back().iterations;
         }
 
         // generate the GL max combo
@@ -607,26 +743,29 @@ int main (int argc, char *argv[]) {
         // TODO factor out the following blocks as they are repeated from above
 
         // re-get posterior normalizer
-        vector<long double> comboProbs;
+        vector<ProbFloat> comboProbs;
         for (list<GenotypeCombo>::iterator gc = genotypeCombos.begin(); gc != genotypeCombos.end(); ++gc) {
             comboProbs.push_back(gc->posteriorProb);
         }
-        long double posteriorNormalizer = logsumexp_probs(comboProbs);
+        ProbFloat posteriorNormalizer = logsumexp_probs(comboProbs);
 
-        // recalculate posterior normalizer
-        pVar = 1.0;
-        pHom = 0.0;
         // calculates pvar and gets the best het combo
+        // pHom is summed over the homozygous reference combos in log space,
+        // and pVar is its complement
+        vector<ProbFloat> homRefComboProbs;
         list<GenotypeCombo>::iterator gc = genotypeCombos.begin();
         bestCombo = *gc;
         for ( ; gc != genotypeCombos.end(); ++gc) {
             if (gc->isHomozygous() && gc->alleles().front() == referenceBase) {
-                pVar -= big_exp(gc->posteriorProb - posteriorNormalizer);
-                pHom += big_exp(gc->posteriorProb - posteriorNormalizer);
+                homRefComboProbs.push_back(gc->posteriorProb - posteriorNormalizer);
             } else if (gc == genotypeCombos.begin()) {
                 bestOverallComboIsHet = true;
             }
         }
+        if (!homRefComboProbs.empty()) {
+            pHomln = logsumexp_probs(homRefComboProbs);
+            pVarln = log1mexp(pHomln);
+        }
 
         // report the maximum a posteriori estimate
         // unless we're reporting the GL maximum
@@ -692,13 +831,13 @@ int main (int argc, char *argv[]) {
 
         //if (alts.empty()) alts = genotypeAlleles;
 
-        if (!alts.empty() && (1 - pHom.ToDouble()) >= parameters.PVL || parameters.PVL == 0) {
+        if (!alts.empty() && exp(pVarln) >= parameters.PVL || parameters.PVL == 0) {
 
             vcf::Variant var(parser->variantCallFile);
 
             out << results.vcf(
                 var,
-                pHom,
+                pHomln,
                 bestComboOddsRatio,
                 samples,
                 referenceBase,
@@ -722,7 +861,7 @@ int main (int argc, char *argv[]) {
             for (vector<Allele>::iterator ga =  genotypeAlleles.begin(); ga != genotypeAlleles.end(); ++ga) {
                 if (ga->type == ALLELE_REFERENCE)
                     continue;
-                parser->failedFile
+                failedOut
                     << parser->currentSequenceName << "\t"
                     << position << "\t"
                     << position + ga->length << "\t"
@@ -734,11 +873,206 @@ int main (int argc, char *argv[]) {
 
     }
 
+}
+
+// the state of a worker thread when running with --threads
+class CallerThread {
+public:
+    pthread_t thread;
+    const Parameters* parameters;
+    RegionScheduler* scheduler;
+    Bias* observationBias;
+    Contamination* contaminationEstimates;
+    PackedReference* packedReference;
+    unsigned long total_sites;
+    unsigned long processed_sites;
+};
+
+// claims work units from the scheduler until none remain, calling variants in
+// each using a parser (and BAM readers) belonging to this thread
+void* callVariantsInWorkUnits(void* arg) {
+
+    CallerThread* caller = (CallerThread*) arg;
+    AlleleParser* parser = new AlleleParser(*caller->parameters);
+    parser->packedReference = caller->packedReference;
+
+    int unit;
+    while (caller->scheduler->claim(unit)) {
+        parser->setTarget(caller->scheduler->units.at(unit).target);
+        stringstream out;
+        stringstream failedOut;
+        callVariants(parser, out, failedOut,
+                     *caller->observationBias,
+                     *caller->contaminationEstimates,
+                     caller->total_sites,
+                     caller->processed_sites);
+        caller->scheduler->complete(unit, out.str(), failedOut.str());
+    }
+
+    delete parser;
+    return NULL;
+
+}
+
+// splits the parser's targets into about count regions of similar data
+// volume, returning false if the BAM indexes can't be used to estimate it
+bool planRegions(AlleleParser* parser, int count, vector<BedTarget>& regions) {
+    RegionPlanner planner(parser->referenceSequences);
+    for (vector<string>::iterator b = parser->parameters.bams.begin(); b != parser->parameters.bams.end(); ++b) {
+        if (!planner.addIndex(*b)) {
+            return false;
+        }
+    }
+    return planner.plan(parser->targets, count, regions);
+}
+
+// freebayes main
+int main (int argc, char *argv[]) {
+
+    // install segfault handler
+    signal(SIGSEGV, segfaultHandler);
+
+    AlleleParser* parser = new AlleleParser(argc, argv);
+    Parameters& parameters = parser->parameters;
+
+    ostream& out = *(parser->output);
+
+    Bias observationBias;
+    if (!parameters.alleleObservationBiasFile.empty()) {
+        observationBias.open(parameters.alleleObservationBiasFile);
+    }
+
+    Contamination contaminationEstimates(0.5+parameters.probContamination, parameters.probContamination);
+    if (!parameters.contaminationEstimateFile.empty()) {
+        contaminationEstimates.open(parameters.contaminationEstimateFile);
+    }
+    vector<string> readGroupIDs;
+    for (vector<ReadGroup>::iterator r = parser->readGroups.begin(); r != parser->readGroups.end(); ++r) {
+        readGroupIDs.push_back(*r->id);
+    }
+    contaminationEstimates.indexReadGroups(readGroupIDs);
+
+    if (parameters.planRegions > 0) {
+        if (parser->targets.empty()) {
+            parser->loadTargetsFromBams();
+        }
+        vector<BedTarget> regions;
+        if (!planRegions(parser, parameters.planRegions, regions)) {
+            ERROR("could not estimate the data volume of the targets from the BAM indexes");
+            exit(1);
+        }
+        for (vector<BedTarget>::iterator r = regions.begin(); r != regions.end(); ++r) {
+            out << r->seq << ":" << r->left << "-" << r->right << endl;
+        }
+        delete parser;
+        return 0;
+    }
+
+    // load the reference once for all the threads
+    PackedReference* packedReference = NULL;
+    if (parameters.referenceInMemory) {
+        packedReference = new PackedReference;
+        packedReference->load(parser->reference);
+        parser->packedReference = packedReference;
+    }
+
+    // this can be uncommented to force operation on a specific set of genotypes
+    vector<Allele> allGenotypeAlleles;
+    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "A", 1));
+    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "T", 1));
+    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "G", 1));
+    allGenotypeAlleles.push_back(genotypeAllele(ALLELE_GENOTYPE, "C", 1));
+
+    // output VCF header, unless it was written before the checkpoint we resume from
+    if (parameters.output == "vcf" && !parser->checkpoint.resumed) {
+        out << parser->variantCallFile.header << endl;
+    }
+
+    unsigned long total_sites = 0;
+    unsigned long processed_sites = 0;
+
+    // runs which may be resumed are processed in work units, so that their
+    // progress can be recorded
+    if (parameters.threads > 1 || !parameters.checkpointFile.empty()) {
+
+        // without targets, process every reference sequence in the BAM header
+        if (parser->targets.empty()) {
+            parser->loadTargetsFromBams();
+        }
+
+        // balance the work between threads using the data volume recorded in
+        // the BAM indexes, falling back to regions of fixed size
+        // a resumed run keeps the units of the run it resumes, which were
+        // planned for that run's --threads
+        Checkpoint& checkpoint = parser->checkpoint;
+        vector<BedTarget> regions;
+        int unitSize = 0;
+        if (checkpoint.resumed && !checkpoint.units.empty()) {
+            if (checkpoint.targetSignature != regionSignature(parser->targets)) {
+                cerr << "ERROR(freebayes): checkpoint " << checkpoint.file
+                     << " was saved by a run over different targets" << endl;
+                exit(1);
+            }
+            regions = checkpoint.units;
+        } else if (!planRegions(parser, parameters.threads * PLANNED_REGIONS_PER_THREAD, regions)) {
+            DEBUG("could not plan regions from the BAM indexes, using regions of " << DEFAULT_WORK_UNIT_SIZE << "bp");
+            regions = parser->targets;
+            unitSize = DEFAULT_WORK_UNIT_SIZE;
+        }
+
+        checkpoint.targetSignature = regionSignature(parser->targets);
+
+        RegionScheduler scheduler(regions,
+                                  unitSize,
+                                  parameters.threads * PENDING_WORK_UNITS_PER_THREAD);
+        if (checkpoint.resumed) {
+            scheduler.resume(checkpoint);
+            DEBUG("resuming from checkpoint after " << checkpoint.written << " work units");
+        }
+        DEBUG("processing " << scheduler.units.size() << " work units using " << parameters.threads << " threads");
+
+        vector<CallerThread> callers(parameters.threads);
+        for (vector<CallerThread>::iterator c = callers.begin(); c != callers.end(); ++c) {
+            c->parameters = &parameters;
+            c->scheduler = &scheduler;
+            c->observationBias = &observationBias;
+            c->contaminationEstimates = &contaminationEstimates;
+            c->packedReference = parser->packedReference;
+            c->total_sites = 0;
+            c->processed_sites = 0;
+            if (pthread_create(&c->thread, NULL, callVariantsInWorkUnits, &*c)) {
+                ERROR("could not start worker thread");
+                exit(1);
+            }
+        }
+
+        // write the output of the workers in order as it becomes available
+        scheduler.write(out, parser->failedFile,
+                        parameters.checkpointFile.empty() ? NULL : &parser->checkpoint);
+
+        for (vector<CallerThread>::iterator c = callers.begin(); c != callers.end(); ++c) {
+            pthread_join(c->thread, NULL);
+            total_sites += c->total_sites;
+            processed_sites += c->processed_sites;
+        }
+
+        // the run is complete, so there is nothing to resume
+        if (!parameters.checkpointFile.empty()) {
+            parser->checkpoint.remove();
+        }
+
+    } else {
+        callVariants(parser, out, parser->failedFile,
+                     observationBias, contaminationEstimates,
+                     total_sites, processed_sites);
+    }
+
     DEBUG("total sites: " << total_sites << endl
           << "processed sites: " << processed_sites << endl
           << "ratio: " << (float) processed_sites / (float) total_sites);
 
     delete parser;
+    delete packedReference;
 
     return 0;
 
@@ -16,13 +16,15 @@ std::vector<std::string> split(const std::string &s, char delim) {
 
 std::vector<std::string> &split(const std::string &s, const std::string& delims, std::vector<std::string> &elems) {
     char* tok;
+    char* saveptr;
     char cchars [s.size()+1];
     char* cstr = &cchars[0];
     strcpy(cstr, s.c_str());
-    tok = strtok(cstr, delims.c_str());
+    // strtok_r, as we may be splitting in several threads at once
+    tok = strtok_r(cstr, delims.c_str(), &saveptr);
     while (tok != NULL) {
         elems.push_back(tok);
-        tok = strtok(NULL, delims.c_str());
+        tok = strtok_r(NULL, delims.c_str(), &saveptr);
     }
     return elems;
 }
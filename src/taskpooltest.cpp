@@ -0,0 +1,73 @@
+// runs many short batches back to back on a TaskPool, checking that every
+// task of each batch runs exactly once, and only while its batch runs
+
+#include "TaskPool.h"
+#include <string.h>
+#include <sched.h>
+
+#define THREADS 6
+#define BATCHES 50000
+#define MAX_TASKS 16
+
+class Batch {
+public:
+    volatile int runs[MAX_TASKS];
+    volatile int wrongBatch;
+};
+
+static Batch* current = NULL;
+
+static void countRun(int i, void* data) {
+    Batch* b = (Batch*) data;
+    if (b != current) {
+        __sync_fetch_and_add(&b->wrongBatch, 1);
+    }
+    __sync_fetch_and_add(&b->runs[i], 1);
+    // give other threads a chance to wake in the middle of the batch
+    if (i % 3 == 0) {
+        sched_yield();
+    }
+}
+
+int main(int argc, char** argv) {
+
+    TaskPool pool(THREADS);
+    // alternating between two batch records makes a task run with the state
+    // of the wrong batch show up as a count in the other record
+    Batch batches[2];
+    int failures = 0;
+
+    for (int n = 0; n < BATCHES; ++n) {
+        Batch& b = batches[n % 2];
+        memset((void*) b.runs, 0, sizeof(b.runs));
+        b.wrongBatch = 0;
+        current = &b;
+        // vary the size of the batches, including ones smaller than the pool
+        int count = 2 + n % (MAX_TASKS - 1);
+        pool.run(count, &countRun, &b);
+        current = NULL;
+        for (int i = 0; i < MAX_TASKS; ++i) {
+            int expected = (i < count) ? 1 : 0;
+            if (b.runs[i] != expected) {
+                cerr << "batch " << n << ": task " << i << " ran " << b.runs[i]
+                     << " times, expected " << expected << endl;
+                ++failures;
+            }
+        }
+        if (b.wrongBatch) {
+            cerr << "batch " << n << ": " << b.wrongBatch << " tasks ran outside of their batch" << endl;
+            ++failures;
+        }
+        if (failures > 10) {
+            break;
+        }
+    }
+
+    if (failures) {
+        cerr << "taskpooltest: FAILED" << endl;
+        return 1;
+    }
+    cerr << "taskpooltest: ran " << BATCHES << " batches on " << THREADS << " threads" << endl;
+    return 0;
+
+}